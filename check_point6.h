@@ -4,6 +4,26 @@
 #include <string>
 #include <iostream>
 #include <vector>
+#include <cmath>
+#include <algorithm>
+#include <memory>
+#include <thread>
+#include <exception>
+#include <stdexcept>
+
+// Средний радиус Земли, км
+const double EARTH_RADIUS_KM = 6371.0;
+
+// Расстояние по большому кругу между двумя точками (формула гаверсинусов), км
+inline double haversineDistance(double lat1, double lon1, double lat2, double lon2) {
+    const double toRad = M_PI / 180.0;
+    double dLat = (lat2 - lat1) * toRad;
+    double dLon = (lon2 - lon1) * toRad;
+    double a = std::sin(dLat / 2) * std::sin(dLat / 2) +
+               std::cos(lat1 * toRad) * std::cos(lat2 * toRad) *
+               std::sin(dLon / 2) * std::sin(dLon / 2);
+    return 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(std::min(1.0, a)));
+}
 
 class CheckPoint {
 public:
@@ -24,7 +44,7 @@ public:
 
     virtual ~CheckPoint() {}
 
-    std::string getName() const { return name; }
+    const std::string& getName() const { return name; }
     double getLatitude() const { return latitude; }
     double getLongitude() const { return longitude; }
     Type getType() const { return type; }
@@ -67,19 +87,163 @@ public:
     virtual ~CheckPointListBuilder() {}
     virtual void addCheckPoint(const CheckPoint& checkPoint) = 0;
     virtual void reset() = 0;
+
+    // Пустой builder для части списка, начинающейся с КП номер firstIndex.
+    // nullptr означает, что builder не умеет работать по частям и Director
+    // прогонит через него весь список целиком.
+    virtual CheckPointListBuilder* createChunkBuilder(size_t /*firstIndex*/) const { return nullptr; }
+
+    // Присоединение результата части, созданной createChunkBuilder.
+    // Director вызывает merge в порядке следования частей.
+    virtual void merge(const CheckPointListBuilder& /*chunk*/) {}
 };
 
-// Director
+// Director: один проход по списку КП с раздачей каждого КП всем builder'ам
 class CheckPointListDirector {
 public:
     void setBuilder(CheckPointListBuilder* builder) {
         builder_ = builder;
+        builders_.clear();
+        if (builder != nullptr) {
+            builders_.push_back(builder);
+        }
     }
 
     CheckPointListBuilder* getBuilder() const { return builder_; }
 
+    void addBuilder(CheckPointListBuilder* builder) {
+        if (builder == nullptr) {
+            throw std::invalid_argument("Builder pointer cannot be null.");
+        }
+        if (builder_ == nullptr) {
+            builder_ = builder;
+        }
+        builders_.push_back(builder);
+    }
+
+    void clearBuilders() {
+        builder_ = nullptr;
+        builders_.clear();
+    }
+
+    const std::vector<CheckPointListBuilder*>& getBuilders() const { return builders_; }
+
+    // Число потоков для construct; 1 — последовательный режим
+    void setThreadCount(size_t threadCount) {
+        threadCount_ = threadCount == 0 ? 1 : threadCount;
+    }
+
+    size_t getThreadCount() const { return threadCount_; }
+
+    // КП добавляются к уже накопленному в builder'ах, reset() не вызывается
+    void construct(const std::vector<CheckPoint*>& checkPoints) {
+        constructRange(checkPoints.size(), [&checkPoints](size_t i) -> const CheckPoint& { return *checkPoints[i]; });
+    }
+
+    void construct(const std::vector<const CheckPoint*>& checkPoints) {
+        constructRange(checkPoints.size(), [&checkPoints](size_t i) -> const CheckPoint& { return *checkPoints[i]; });
+    }
+
+    void construct(const std::vector<CheckPoint>& checkPoints) {
+        constructRange(checkPoints.size(), [&checkPoints](size_t i) -> const CheckPoint& { return checkPoints[i]; });
+    }
+
 protected:
     CheckPointListBuilder* builder_ = nullptr;
+    std::vector<CheckPointListBuilder*> builders_;
+    size_t threadCount_ = 1;
+
+    // Меньше КП на поток не имеет смысла делить
+    static const size_t minChunkSize = 4096;
+
+    template <typename Get>
+    static void feed(const std::vector<CheckPointListBuilder*>& builders, size_t from, size_t to, Get get) {
+        for (size_t i = from; i < to; ++i) {
+            const CheckPoint& checkPoint = get(i);
+            for (CheckPointListBuilder* builder : builders) {
+                builder->addCheckPoint(checkPoint);
+            }
+        }
+    }
+
+    template <typename Get>
+    void constructRange(size_t count, Get get) {
+        size_t chunkCount = std::min(threadCount_, count / minChunkSize);
+        if (chunkCount <= 1) {
+            feed(builders_, 0, count, get);
+            return;
+        }
+
+        size_t chunkSize = (count + chunkCount - 1) / chunkCount;
+
+        // Builder'ы без поддержки частей обрабатываются целиком в текущем потоке
+        std::vector<CheckPointListBuilder*> sequential;
+        std::vector<CheckPointListBuilder*> parallel;
+        std::vector<std::vector<std::unique_ptr<CheckPointListBuilder>>> owned(chunkCount);
+        std::vector<std::vector<CheckPointListBuilder*>> chunkBuilders(chunkCount);
+
+        for (CheckPointListBuilder* builder : builders_) {
+            std::unique_ptr<CheckPointListBuilder> first(builder->createChunkBuilder(0));
+            if (!first) {
+                sequential.push_back(builder);
+                continue;
+            }
+            parallel.push_back(builder);
+            for (size_t c = 0; c < chunkCount; ++c) {
+                std::unique_ptr<CheckPointListBuilder> chunk = c == 0
+                    ? std::move(first)
+                    : std::unique_ptr<CheckPointListBuilder>(builder->createChunkBuilder(c * chunkSize));
+                chunkBuilders[c].push_back(chunk.get());
+                owned[c].push_back(std::move(chunk));
+            }
+        }
+
+        if (parallel.empty()) {
+            feed(sequential, 0, count, get);
+            return;
+        }
+
+        std::vector<std::exception_ptr> errors(chunkCount);
+        std::vector<std::thread> workers;
+        workers.reserve(chunkCount);
+        for (size_t c = 0; c < chunkCount; ++c) {
+            size_t from = c * chunkSize;
+            size_t to = std::min(count, from + chunkSize);
+            workers.emplace_back([&, c, from, to]() {
+                try {
+                    feed(chunkBuilders[c], from, to, get);
+                } catch (...) {
+                    errors[c] = std::current_exception();
+                }
+            });
+        }
+
+        std::exception_ptr sequentialError;
+        try {
+            feed(sequential, 0, count, get);
+        } catch (...) {
+            sequentialError = std::current_exception();
+        }
+
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        if (sequentialError) {
+            std::rethrow_exception(sequentialError);
+        }
+        for (const auto& error : errors) {
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        }
+
+        for (size_t c = 0; c < chunkCount; ++c) {
+            for (size_t j = 0; j < parallel.size(); ++j) {
+                parallel[j]->merge(*chunkBuilders[c][j]);
+            }
+        }
+    }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,195 @@
+#ifndef CHECK_POINT_TABLE_H
+#define CHECK_POINT_TABLE_H
+
+#include "check_point6.h"
+#include <vector>
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include <cmath>
+#include <utility>
+#include <stdexcept>
+
+// Компактное хранилище КП в виде структуры массивов (SoA)
+//
+// Каждое поле лежит в отдельном непрерывном массиве, имена склеены в один
+// пул строк. Ядра ниже — простые циклы без ветвлений и виртуальных вызовов
+// по этим массивам, их компилятор векторизует сам (для ядер с sin/asin нужен
+// -O3 -ffast-math, чтобы задействовать векторную libm).
+class CheckPointTable {
+private:
+    std::vector<double> latitudes;
+    std::vector<double> longitudes;
+    std::vector<double> cosLatitudes;  // cos(широты), кэш для формулы гаверсинусов
+    std::vector<double> penalties;
+    std::vector<std::uint8_t> types;
+    std::vector<std::uint32_t> nameOffsets;  // nameOffsets[i]..nameOffsets[i + 1] в namePool
+    std::string namePool;
+
+    static constexpr double toRad = M_PI / 180.0;
+
+public:
+    CheckPointTable() : nameOffsets{0} {}
+
+    void reserve(size_t count) {
+        latitudes.reserve(count);
+        longitudes.reserve(count);
+        cosLatitudes.reserve(count);
+        penalties.reserve(count);
+        types.reserve(count);
+        nameOffsets.reserve(count + 1);
+    }
+
+    void clear() {
+        latitudes.clear();
+        longitudes.clear();
+        cosLatitudes.clear();
+        penalties.clear();
+        types.clear();
+        nameOffsets.assign(1, 0);
+        namePool.clear();
+    }
+
+    void add(std::string_view name, double latitude, double longitude, CheckPoint::Type type, double penalty) {
+        latitudes.push_back(latitude);
+        longitudes.push_back(longitude);
+        cosLatitudes.push_back(std::cos(latitude * toRad));
+        penalties.push_back(type == CheckPoint::Type::OPTIONAL ? penalty : 0.0);
+        types.push_back(static_cast<std::uint8_t>(type));
+        namePool.append(name.data(), name.size());
+        nameOffsets.push_back(static_cast<std::uint32_t>(namePool.size()));
+    }
+
+    void add(const CheckPoint& checkPoint) {
+        add(checkPoint.getName(), checkPoint.getLatitude(), checkPoint.getLongitude(),
+            checkPoint.getType(), checkPoint.getPenalty());
+    }
+
+    void append(const CheckPointTable& other) {
+        latitudes.insert(latitudes.end(), other.latitudes.begin(), other.latitudes.end());
+        longitudes.insert(longitudes.end(), other.longitudes.begin(), other.longitudes.end());
+        cosLatitudes.insert(cosLatitudes.end(), other.cosLatitudes.begin(), other.cosLatitudes.end());
+        penalties.insert(penalties.end(), other.penalties.begin(), other.penalties.end());
+        types.insert(types.end(), other.types.begin(), other.types.end());
+        std::uint32_t base = static_cast<std::uint32_t>(namePool.size());
+        for (size_t i = 1; i < other.nameOffsets.size(); ++i) {
+            nameOffsets.push_back(base + other.nameOffsets[i]);
+        }
+        namePool += other.namePool;
+    }
+
+    size_t size() const { return latitudes.size(); }
+    bool empty() const { return latitudes.empty(); }
+
+    std::string_view getName(size_t i) const {
+        return std::string_view(namePool).substr(nameOffsets[i], nameOffsets[i + 1] - nameOffsets[i]);
+    }
+    double getLatitude(size_t i) const { return latitudes[i]; }
+    double getLongitude(size_t i) const { return longitudes[i]; }
+    double getPenalty(size_t i) const { return penalties[i]; }
+    CheckPoint::Type getType(size_t i) const { return static_cast<CheckPoint::Type>(types[i]); }
+
+    const double* latitudeData() const { return latitudes.data(); }
+    const double* longitudeData() const { return longitudes.data(); }
+    const double* penaltyData() const { return penalties.data(); }
+    const std::uint8_t* typeData() const { return types.data(); }
+
+    // Суммарный штраф; у обязательных КП в penalties хранится 0
+    double totalPenalty() const {
+        const double* p = penalties.data();
+        const size_t n = penalties.size();
+        double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+        size_t i = 0;
+        for (; i + 4 <= n; i += 4) {
+            acc[0] += p[i];
+            acc[1] += p[i + 1];
+            acc[2] += p[i + 2];
+            acc[3] += p[i + 3];
+        }
+        for (; i < n; ++i) {
+            acc[0] += p[i];
+        }
+        return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+    }
+
+    // Расстояния от точки (latitude, longitude) до всех КП, км; out должен вмещать size() значений
+    void distancesFrom(double latitude, double longitude, double* out) const {
+        const double* lat = latitudes.data();
+        const double* lon = longitudes.data();
+        const double* cosLat = cosLatitudes.data();
+        const double lat0 = latitude * toRad;
+        const double lon0 = longitude * toRad;
+        const double cosLat0 = std::cos(lat0);
+        const size_t n = latitudes.size();
+        for (size_t i = 0; i < n; ++i) {
+            double sLat = std::sin((lat[i] * toRad - lat0) * 0.5);
+            double sLon = std::sin((lon[i] * toRad - lon0) * 0.5);
+            double a = sLat * sLat + cosLat0 * cosLat[i] * sLon * sLon;
+            a = a < 1.0 ? a : 1.0;
+            out[i] = 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(a));
+        }
+    }
+
+    std::vector<double> distancesFrom(double latitude, double longitude) const {
+        std::vector<double> result(size());
+        distancesFrom(latitude, longitude, result.data());
+        return result;
+    }
+
+    // Длина маршрута при обходе КП в порядке хранения, км
+    double routeLength() const {
+        const double* lat = latitudes.data();
+        const double* lon = longitudes.data();
+        const double* cosLat = cosLatitudes.data();
+        const size_t n = latitudes.size();
+        double total = 0.0;
+        for (size_t i = 1; i < n; ++i) {
+            double sLat = std::sin((lat[i] - lat[i - 1]) * toRad * 0.5);
+            double sLon = std::sin((lon[i] - lon[i - 1]) * toRad * 0.5);
+            double a = sLat * sLat + cosLat[i - 1] * cosLat[i] * sLon * sLon;
+            a = a < 1.0 ? a : 1.0;
+            total += 2.0 * EARTH_RADIUS_KM * std::asin(std::sqrt(a));
+        }
+        return total;
+    }
+};
+
+// Concrete Builder 4: Перекладка КП в CheckPointTable
+class CheckPointTableBuilder : public CheckPointListBuilder {
+private:
+    CheckPointTable table;
+
+public:
+    void reset() override {
+        table.clear();
+    }
+
+    void addCheckPoint(const CheckPoint& checkPoint) override {
+        table.add(checkPoint);
+    }
+
+    void reserve(size_t count) { table.reserve(count); }
+
+    CheckPointListBuilder* createChunkBuilder(size_t) const override {
+        return new CheckPointTableBuilder();
+    }
+
+    void merge(const CheckPointListBuilder& chunk) override {
+        const CheckPointTableBuilder* other = dynamic_cast<const CheckPointTableBuilder*>(&chunk);
+        if (other == nullptr) {
+            throw std::invalid_argument("Cannot merge a different builder type into CheckPointTableBuilder.");
+        }
+        table.append(other->table);
+    }
+
+    const CheckPointTable& getTable() const { return table; }
+
+    // Забрать таблицу без копирования; builder остаётся пустым
+    CheckPointTable takeTable() {
+        CheckPointTable result = std::move(table);
+        table.clear();
+        return result;
+    }
+};
+
+#endif
@@ -4,34 +4,130 @@
 #include "check_point6.h"
 #include <vector>
 #include <numeric>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <system_error>
+#include <utility>
 
 // Concrete Builder 1: Вывод списка КП в текстовом виде
+//
+// Текст собирается в одном буфере без временных строк: числа печатаются
+// std::to_chars прямо в стековый массив. Если задан поток вывода, буфер
+// сбрасывается в него порциями по flushThreshold байт, и память не растёт
+// с числом КП.
 class TextListBuilder : public CheckPointListBuilder {
 private:
     std::string textList;
     int checkpoint_counter = 0;
+    std::ostream* output = nullptr;
+
+    static const size_t flushThreshold = 64 * 1024;
+
+    void appendNumber(int value) {
+        char buffer[16];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+        textList.append(buffer, result.ptr);
+    }
+
+    // Тот же формат, что у std::to_string(double): шесть знаков после точки
+    void appendNumber(double value) {
+        char buffer[64];
+        auto result = std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, 6);
+        if (result.ec == std::errc()) {
+            textList.append(buffer, result.ptr);
+        } else {
+            textList += std::to_string(value);
+        }
+    }
 
 public:
+    TextListBuilder() {}
+
+    // Режим потокового вывода: текст уходит в output, а не копится в памяти.
+    // Остаток дописывается в output при reset() и при разрушении builder'а
+    explicit TextListBuilder(std::ostream& output) : output(&output) {}
+
+    ~TextListBuilder() override {
+        // Исключения потока (если они включены) из деструктора не выпускаем
+        try {
+            flush();
+        } catch (...) {
+        }
+    }
+
     void reset() override {
-        textList = "";
+        flush();
+        textList.clear();
         checkpoint_counter = 0;
     }
 
+    void reserve(size_t bytes) { textList.reserve(bytes); }
+
     void addCheckPoint(const CheckPoint& checkPoint) override {
         checkpoint_counter++;
-        textList += std::to_string(checkpoint_counter) + ". ";
-        textList += checkPoint.getName() + ", ";
-        textList += "Latitude: " + std::to_string(checkPoint.getLatitude()) + ", ";
-        textList += "Longitude: " + std::to_string(checkPoint.getLongitude()) + ", ";
+        appendNumber(checkpoint_counter);
+        textList += ". ";
+        textList += checkPoint.getName();
+        textList += ", Latitude: ";
+        appendNumber(checkPoint.getLatitude());
+        textList += ", Longitude: ";
+        appendNumber(checkPoint.getLongitude());
 
         if (checkPoint.getType() == CheckPoint::Type::OPTIONAL) {
-            textList += "Penalty: " + std::to_string(checkPoint.getPenalty()) + "\n";
+            textList += ", Penalty: ";
+            appendNumber(checkPoint.getPenalty());
+            textList += "\n";
         } else {
-            textList += "Не зачёт СУ\n";
+            textList += ", Не зачёт СУ\n";
+        }
+
+        if (output != nullptr && textList.size() >= flushThreshold) {
+            flush();
+        }
+    }
+
+    // Сброс накопленного текста в поток вывода (если он задан)
+    void flush() {
+        if (output != nullptr && !textList.empty()) {
+            output->write(textList.data(), static_cast<std::streamsize>(textList.size()));
+            textList.clear();
+        }
+    }
+
+    CheckPointListBuilder* createChunkBuilder(size_t firstIndex) const override {
+        TextListBuilder* chunk = new TextListBuilder();
+        chunk->checkpoint_counter = checkpoint_counter + static_cast<int>(firstIndex);
+        return chunk;
+    }
+
+    void merge(const CheckPointListBuilder& chunk) override {
+        const TextListBuilder* other = dynamic_cast<const TextListBuilder*>(&chunk);
+        if (other == nullptr) {
+            throw std::invalid_argument("Cannot merge a different builder type into TextListBuilder.");
+        }
+        textList += other->textList;
+        checkpoint_counter = other->checkpoint_counter;
+        if (output != nullptr && textList.size() >= flushThreshold) {
+            flush();
         }
     }
 
+    // В потоковом режиме — только ещё не сброшенный в output остаток
     std::string getTextList() const { return textList; }
+
+    // Текст без копирования; действителен до следующего изменения builder'а.
+    // В потоковом режиме — только ещё не сброшенный в output остаток
+    std::string_view getTextView() const { return textList; }
+
+    // Забрать текст без копирования; builder остаётся пустым, нумерация продолжается.
+    // В потоковом режиме — только ещё не сброшенный остаток, в output он уже не попадёт
+    std::string takeTextList() {
+        std::string result = std::move(textList);
+        textList.clear();
+        return result;
+    }
 };
 
 // Concrete Builder 2: Подсчёт суммарного штрафа
@@ -50,6 +146,18 @@ public:
         }
     }
 
+    CheckPointListBuilder* createChunkBuilder(size_t) const override {
+        return new PenaltyCalculatorBuilder();
+    }
+
+    void merge(const CheckPointListBuilder& chunk) override {
+        const PenaltyCalculatorBuilder* other = dynamic_cast<const PenaltyCalculatorBuilder*>(&chunk);
+        if (other == nullptr) {
+            throw std::invalid_argument("Cannot merge a different builder type into PenaltyCalculatorBuilder.");
+        }
+        totalPenalty += other->totalPenalty;
+    }
+
     double getTotalPenalty() const { return totalPenalty; }
 };
 
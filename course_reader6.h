@@ -0,0 +1,217 @@
+#ifndef COURSE_READER_H
+#define COURSE_READER_H
+
+#include "check_point6.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <charconv>
+#include <stdexcept>
+#include <system_error>
+#include <cstring>
+#include <cstdint>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Потоковое чтение файла дистанции в формате CSV:
+//
+//     name,latitude,longitude[,penalty]
+//
+// Строка со штрафом задаёт необязательный КП, без штрафа — обязательный.
+// Пустые строки и строки, начинающиеся с '#', пропускаются; первая строка
+// пропускается, если в ней нет координат (заголовок).
+//
+// Файл отображается в память целиком, числа разбираются std::from_chars прямо
+// из отображения. Каждая строка сразу передаётся builder'ам через один и тот
+// же переиспользуемый объект КП, поэтому список КП в памяти не строится, а
+// прочитанные страницы файла отдаются системе по мере продвижения.
+class CourseFileReader {
+private:
+    // КП, который переиспользуется для всех строк файла
+    class ParsedCheckPoint : public CheckPoint {
+    private:
+        double penalty = 0.0;
+
+    public:
+        ParsedCheckPoint() : CheckPoint("", 0.0, 0.0, CheckPoint::Type::MANDATORY) {}
+
+        void assign(std::string_view newName, double newLatitude, double newLongitude,
+                    CheckPoint::Type newType, double newPenalty) {
+            name.assign(newName.data(), newName.size());
+            latitude = newLatitude;
+            longitude = newLongitude;
+            type = newType;
+            penalty = newPenalty;
+        }
+
+        double getPenalty() const override { return penalty; }
+
+        void print(std::ostream& os) const override {
+            CheckPoint::print(os);
+            if (type == CheckPoint::Type::OPTIONAL) {
+                os << ", Penalty: " << penalty;
+            }
+        }
+    };
+
+    // Сколько прочитанных байт накапливать перед возвратом страниц системе
+    static const size_t releaseStep = 16 * 1024 * 1024;
+
+    const char* data = nullptr;
+    size_t length = 0;
+
+    static bool parseDouble(std::string_view field, double& value) {
+        while (!field.empty() && (field.front() == ' ' || field.front() == '\t')) field.remove_prefix(1);
+        while (!field.empty() && (field.back() == ' ' || field.back() == '\t')) field.remove_suffix(1);
+        if (field.empty()) return false;
+        if (field.front() == '+') field.remove_prefix(1);
+        auto result = std::from_chars(field.data(), field.data() + field.size(), value);
+        return result.ec == std::errc() && result.ptr == field.data() + field.size();
+    }
+
+    static std::string lineError(size_t lineNumber, const char* what) {
+        return "Course file line " + std::to_string(lineNumber) + ": " + what;
+    }
+
+public:
+    explicit CourseFileReader(const std::string& path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open course file '" + path + "': " + std::strerror(errno));
+        }
+
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot stat course file '" + path + "': " + std::strerror(error));
+        }
+
+        length = static_cast<size_t>(st.st_size);
+        if (length > 0) {
+            void* mapped = ::mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapped == MAP_FAILED) {
+                int error = errno;
+                ::close(fd);
+                throw std::runtime_error("Cannot map course file '" + path + "': " + std::strerror(error));
+            }
+            data = static_cast<const char*>(mapped);
+            ::madvise(mapped, length, MADV_SEQUENTIAL);
+        }
+        ::close(fd);
+    }
+
+    ~CourseFileReader() {
+        if (data != nullptr) {
+            ::munmap(const_cast<char*>(data), length);
+        }
+    }
+
+    CourseFileReader(const CourseFileReader&) = delete;
+    CourseFileReader& operator=(const CourseFileReader&) = delete;
+
+    size_t size() const { return length; }
+
+    // Разбор произвольного буфера; возвращает число прочитанных КП
+    static size_t parse(const char* text, size_t textLength, const std::vector<CheckPointListBuilder*>& builders) {
+        return parseImpl(text, textLength, builders, false);
+    }
+
+    size_t read(const std::vector<CheckPointListBuilder*>& builders) const {
+        return parseImpl(data, length, builders, true);
+    }
+
+    size_t read(CheckPointListBuilder& builder) const {
+        return read(std::vector<CheckPointListBuilder*>{&builder});
+    }
+
+private:
+    static size_t parseImpl(const char* text, size_t textLength, const std::vector<CheckPointListBuilder*>& builders,
+                            bool releasePages) {
+        ParsedCheckPoint checkPoint;
+        bool firstRow = true;
+        size_t count = 0;
+        size_t lineNumber = 0;
+        const char* pos = text;
+        const char* end = text + textLength;
+        const char* released = text;
+
+        while (pos < end) {
+            const char* newline = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+            const char* lineEnd = newline ? newline : end;
+            std::string_view line(pos, lineEnd - pos);
+            pos = newline ? newline + 1 : end;
+            ++lineNumber;
+
+            if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+            if (line.empty() || line.front() == '#') continue;
+
+            std::string_view fields[4];
+            size_t fieldCount = 0;
+            size_t start = 0;
+            while (fieldCount < 4) {
+                size_t comma = line.find(',', start);
+                if (comma == std::string_view::npos) {
+                    fields[fieldCount++] = line.substr(start);
+                    start = line.size() + 1;
+                    break;
+                }
+                fields[fieldCount++] = line.substr(start, comma - start);
+                start = comma + 1;
+            }
+            if (start <= line.size()) {
+                throw std::runtime_error(lineError(lineNumber, "too many fields"));
+            }
+
+            bool header = firstRow;
+            firstRow = false;
+
+            double latitude = 0.0;
+            double longitude = 0.0;
+            if (fieldCount < 3 || !parseDouble(fields[1], latitude) || !parseDouble(fields[2], longitude)) {
+                if (header) continue;
+                throw std::runtime_error(lineError(lineNumber, "expected name,latitude,longitude[,penalty]"));
+            }
+
+            double penalty = 0.0;
+            CheckPoint::Type type = CheckPoint::Type::MANDATORY;
+            if (fieldCount == 4 && fields[3].find_first_not_of(" \t") != std::string_view::npos) {
+                if (!parseDouble(fields[3], penalty)) {
+                    throw std::runtime_error(lineError(lineNumber, "invalid penalty"));
+                }
+                type = CheckPoint::Type::OPTIONAL;
+            }
+
+            checkPoint.assign(fields[0], latitude, longitude, type, penalty);
+            for (CheckPointListBuilder* builder : builders) {
+                builder->addCheckPoint(checkPoint);
+            }
+            ++count;
+
+            if (releasePages && static_cast<size_t>(pos - released) >= releaseStep) {
+                releaseRange(released, pos);
+                released = pos;
+            }
+        }
+
+        if (releasePages) {
+            releaseRange(released, end);
+        }
+        return count;
+    }
+
+    // Возврат уже прочитанных страниц отображения, чтобы RSS не рос с размером файла
+    static void releaseRange(const char* from, const char* to) {
+        const uintptr_t pageSize = static_cast<uintptr_t>(::sysconf(_SC_PAGESIZE));
+        uintptr_t begin = (reinterpret_cast<uintptr_t>(from) + pageSize - 1) & ~(pageSize - 1);
+        uintptr_t finish = reinterpret_cast<uintptr_t>(to) & ~(pageSize - 1);
+        if (finish > begin) {
+            ::madvise(reinterpret_cast<void*>(begin), finish - begin, MADV_DONTNEED);
+        }
+    }
+};
+
+#endif
@@ -1,3 +1,6 @@
+#ifndef HW_PROD2_H
+#define HW_PROD2_H
+
 #include <type_traits>
 #include <cstddef>
 
@@ -145,4 +148,6 @@ namespace TypeList {
 
     template<typename List, std::size_t Index>
     using TypeAt = typename TypeListDetails::TypeAt<List, Index>::type;
-} // namespace TypeList
\ No newline at end of file
+} // namespace TypeList
+
+#endif
@@ -0,0 +1,210 @@
+#include "soa_vector2.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cstdio>
+#include <algorithm>
+
+// Замеры SoAVector против std::vector<struct>:
+//     g++ -std=c++17 -O2 hw_prod2_bench.cpp && ./a.out
+// (с -O3 -march=native циклы по столбцам векторизуются шире)
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Компоненты сущности; у каждого свой тип, чтобы он задавал столбец
+struct Position {
+    float x, y, z;
+};
+
+struct Velocity {
+    float x, y, z;
+};
+
+struct Health {
+    float value;
+};
+
+struct Flags {
+    std::uint32_t bits;
+};
+
+// Холодные данные: в AoS они делят кэш-линии с горячими полями
+struct Name {
+    char text[32];
+};
+
+static const std::uint32_t MOVING = 1;
+
+using Entities = SoAVector<TypeList::TypeListType<Position, Velocity, Health, Flags, Name>>;
+
+struct Entity {
+    Position position;
+    Velocity velocity;
+    Health health;
+    Flags flags;
+    Name name;
+};
+
+// Лучшее из нескольких повторов, мс
+template <typename Function>
+static double bestOf(int repeats, Function&& function) {
+    double best = 1e300;
+    for (int i = 0; i < repeats; ++i) {
+        auto start = Clock::now();
+        function();
+        best = std::min(best, elapsedMs(start));
+    }
+    return best;
+}
+
+// Четыре независимые суммы, чтобы цикл упирался в память, а не в задержку сложения
+template <typename Read>
+static double sum4(std::size_t n, Read read) {
+    double acc[4] = { 0.0, 0.0, 0.0, 0.0 };
+    std::size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc[0] += read(i);
+        acc[1] += read(i + 1);
+        acc[2] += read(i + 2);
+        acc[3] += read(i + 3);
+    }
+    for (; i < n; ++i) acc[0] += read(i);
+    return (acc[0] + acc[1]) + (acc[2] + acc[3]);
+}
+
+static double sumHealth(const Entities& entities) {
+    ColumnSpan<const Health> health = entities.column<Health>();
+    return sum4(health.size(), [&](std::size_t i) { return health[i].value; });
+}
+
+static double sumHealth(const std::vector<Entity>& entities) {
+    const Entity* data = entities.data();
+    return sum4(entities.size(), [&](std::size_t i) { return data[i].health.value; });
+}
+
+// Сдвиг движущихся сущностей: читает три столбца, пишет один
+static void move(Entities& entities, float dt) {
+    ColumnSpan<Position> positions = entities.column<Position>();
+    ColumnSpan<const Velocity> velocities = static_cast<const Entities&>(entities).column<Velocity>();
+    ColumnSpan<const Flags> flags = static_cast<const Entities&>(entities).column<Flags>();
+    const std::size_t n = entities.size();
+    for (std::size_t i = 0; i < n; ++i) {
+        if (flags[i].bits & MOVING) {
+            positions[i].x += velocities[i].x * dt;
+            positions[i].y += velocities[i].y * dt;
+            positions[i].z += velocities[i].z * dt;
+        }
+    }
+}
+
+// То же через строки: кортеж ссылок на элементы столбцов
+static void moveRows(Entities& entities, float dt) {
+    for (auto [position, velocity, health, flags, name] : entities.rows()) {
+        if (flags.bits & MOVING) {
+            position.x += velocity.x * dt;
+            position.y += velocity.y * dt;
+            position.z += velocity.z * dt;
+        }
+    }
+}
+
+static void move(std::vector<Entity>& entities, float dt) {
+    for (Entity& entity : entities) {
+        if (entity.flags.bits & MOVING) {
+            entity.position.x += entity.velocity.x * dt;
+            entity.position.y += entity.velocity.y * dt;
+            entity.position.z += entity.velocity.z * dt;
+        }
+    }
+}
+
+static double sumPositions(const Entities& entities) {
+    double sum = 0.0;
+    for (const Position& position : entities.column<Position>()) sum += position.x + position.y + position.z;
+    return sum;
+}
+
+static double sumPositions(const std::vector<Entity>& entities) {
+    double sum = 0.0;
+    for (const Entity& entity : entities) sum += entity.position.x + entity.position.y + entity.position.z;
+    return sum;
+}
+
+static void benchSoAVector() {
+    const std::size_t rowCount = 10000000;
+    const int repeats = 5;
+    std::cout << "== SoAVector против std::vector<struct>: " << rowCount << " строк по " << sizeof(Entity)
+              << " байт\n";
+
+    std::mt19937 rng(48);
+    std::uniform_real_distribution<float> coordinate(-1000.0f, 1000.0f);
+    std::uniform_real_distribution<float> speed(-5.0f, 5.0f);
+    std::uniform_real_distribution<float> health(0.0f, 100.0f);
+
+    Entities soa;
+    std::vector<Entity> aos;
+    soa.reserve(rowCount);
+    aos.reserve(rowCount);
+    for (std::size_t i = 0; i < rowCount; ++i) {
+        Entity entity;
+        entity.position = { coordinate(rng), coordinate(rng), coordinate(rng) };
+        entity.velocity = { speed(rng), speed(rng), speed(rng) };
+        entity.health = { health(rng) };
+        entity.flags = { rng() % 4 == 0 ? MOVING : 0u };  // движется каждая четвёртая
+        std::memset(entity.name.text, 0, sizeof(entity.name.text));
+        std::snprintf(entity.name.text, sizeof(entity.name.text), "entity-%zu", i);
+        soa.push_back(entity.position, entity.velocity, entity.health, entity.flags, entity.name);
+        aos.push_back(entity);
+    }
+
+    double soaSum = 0.0;
+    double aosSum = 0.0;
+    double soaSumMs = bestOf(repeats, [&] { soaSum = sumHealth(soa); });
+    double aosSumMs = bestOf(repeats, [&] { aosSum = sumHealth(aos); });
+    std::cout << "Сумма по столбцу Health: vector<struct> " << aosSumMs << " мс -> SoAVector " << soaSumMs << " мс"
+              << (soaSum == aosSum ? "" : " (РАСХОЖДЕНИЕ)") << "\n";
+
+    const float dt = 0.01f;
+    double aosMoveMs = bestOf(repeats, [&] { move(aos, dt); });
+    double soaMoveMs = bestOf(repeats, [&] { move(soa, dt); });
+    double rowsMoveMs = bestOf(repeats, [&] { moveRows(soa, dt); });
+    // SoA сдвинут вдвое больше раз: повторяем ещё столько же для vector<struct>
+    bestOf(repeats, [&] { move(aos, dt); });
+    bool same = sumPositions(soa) == sumPositions(aos);
+    std::cout << "Сдвиг движущихся (Flags, Velocity -> Position): vector<struct> " << aosMoveMs
+              << " мс -> SoAVector по столбцам " << soaMoveMs << " мс, по строкам " << rowsMoveMs << " мс"
+              << (same ? "" : " (РАСХОЖДЕНИЕ)") << "\n";
+
+    // Удаление случайных строк: на место удалённой встаёт последняя
+    const std::size_t eraseCount = rowCount / 10;
+    std::vector<std::size_t> victims(eraseCount);
+    for (std::size_t i = 0; i < eraseCount; ++i) victims[i] = rng() % (rowCount - i);
+
+    auto start = Clock::now();
+    for (std::size_t victim : victims) {
+        aos[victim] = aos.back();
+        aos.pop_back();
+    }
+    double aosEraseMs = elapsedMs(start);
+
+    start = Clock::now();
+    for (std::size_t victim : victims) soa.swapErase(victim);
+    double soaEraseMs = elapsedMs(start);
+
+    same = soa.size() == aos.size() && sumHealth(soa) == sumHealth(aos) && sumPositions(soa) == sumPositions(aos) &&
+           std::strcmp(soa.get<Name>(soa.size() / 2).text, aos[aos.size() / 2].name.text) == 0;
+    std::cout << "Удаление " << eraseCount << " случайных строк: vector<struct> " << aosEraseMs << " мс -> SoAVector "
+              << soaEraseMs << " мс" << (same ? "" : " (РАСХОЖДЕНИЕ)") << "\n\n";
+}
+
+int main() {
+    benchSoAVector();
+    return 0;
+}
@@ -1,5 +1,14 @@
 #include <iostream>
 #include <cassert>
+#include <cstddef>
+#include <algorithm>
+#include <vector>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <random>
+#include <chrono>
 
 // MixIn для операторов сравнения
 template <typename T>
@@ -53,11 +62,272 @@ private:
 template <typename T>
 size_t counter<T>::count_ = 0;
 
+// MixIn для выделения памяти из пула
+//
+// Класс получает собственные operator new/delete. Блоки берутся из списков
+// свободных блоков по классам размеров (кратно 16 байтам, до 256 байт),
+// своих у каждого потока, поэтому new/delete обычно обходятся без
+// блокировок. Пустой список пополняется пачкой блоков из общего пула,
+// переполненный отдаёт пачку обратно; общий пул нарезает блоки из кусков
+// (slab) по 256 КБ. Освобождённые блоки возвращаются в пул, но не системе.
+//
+// Блоки больше 256 байт (например, у крупных наследников) берутся из
+// обычного ::operator new. Хуки статистики: класс может объявить
+// статические on_pool_allocate(size_t) и on_pool_release(size_t), они
+// вызываются на каждом new/delete; по умолчанию пустые.
+namespace pool_detail {
+
+struct free_block {
+    free_block* next;
+};
+
+const size_t granularity = 16;
+const size_t max_block_size = 256;
+const size_t class_count = max_block_size / granularity;
+const size_t slab_size = 256 * 1024;
+
+inline size_t class_of(size_t size) {
+    return size == 0 ? 0 : (size - 1) / granularity;
+}
+
+inline size_t block_size(size_t size_class) {
+    return (size_class + 1) * granularity;
+}
+
+// Блоков в пачке между потоком и общим пулом: около 16 КБ
+inline size_t batch_size(size_t size_class) {
+    return std::min<size_t>(256, std::max<size_t>(16, 16384 / block_size(size_class)));
+}
+
+struct pool_stats {
+    size_t slabs = 0;
+    size_t reserved_bytes = 0;  // память, взятая у системы
+    size_t refills = 0;         // пачек, выданных потокам
+    size_t returns = 0;         // пачек, возвращённых потоками
+    size_t pooled_blocks = 0;   // свободных блоков в общем пуле
+};
+
+class central_pool {
+public:
+    // Не разрушается: объекты могут удаляться и из деструкторов статических объектов
+    static central_pool& instance() {
+        static central_pool* pool = new central_pool();
+        return *pool;
+    }
+
+    // Цепочка из count блоков класса size_class
+    free_block* take(size_t size_class, size_t& count) {
+        shelf& s = shelves[size_class];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        ++s.refills;
+        if (!s.batches.empty()) {
+            batch b = s.batches.back();
+            s.batches.pop_back();
+            s.blocks -= b.count;
+            count = b.count;
+            return b.head;
+        }
+
+        const size_t size = block_size(size_class);
+        if (static_cast<size_t>(s.end - s.cursor) < size) {
+            s.cursor = new_slab();
+            s.end = s.cursor + slab_size;
+        }
+        count = std::min(batch_size(size_class), static_cast<size_t>(s.end - s.cursor) / size);
+        free_block* head = reinterpret_cast<free_block*>(s.cursor);
+        for (size_t i = 0; i < count; ++i) {
+            free_block* block = reinterpret_cast<free_block*>(s.cursor + i * size);
+            block->next = i + 1 < count ? reinterpret_cast<free_block*>(s.cursor + (i + 1) * size) : nullptr;
+        }
+        s.cursor += count * size;
+        return head;
+    }
+
+    void give(size_t size_class, free_block* head, size_t count) {
+        shelf& s = shelves[size_class];
+        std::lock_guard<std::mutex> lock(s.mutex);
+        ++s.returns;
+        s.blocks += count;
+        s.batches.push_back({head, count});
+    }
+
+    pool_stats stats() {
+        pool_stats result;
+        {
+            std::lock_guard<std::mutex> lock(slab_mutex);
+            result.slabs = slabs;
+            result.reserved_bytes = slabs * slab_size;
+        }
+        for (shelf& s : shelves) {
+            std::lock_guard<std::mutex> lock(s.mutex);
+            result.refills += s.refills;
+            result.returns += s.returns;
+            result.pooled_blocks += s.blocks;
+        }
+        return result;
+    }
+
+private:
+    struct batch {
+        free_block* head;
+        size_t count;
+    };
+
+    // Общий пул одного класса размеров
+    struct shelf {
+        std::mutex mutex;
+        std::vector<batch> batches;  // цепочки, возвращённые потоками
+        size_t blocks = 0;
+        char* cursor = nullptr;      // ещё не нарезанный остаток slab
+        char* end = nullptr;
+        size_t refills = 0;
+        size_t returns = 0;
+    };
+
+    shelf shelves[class_count];
+    std::mutex slab_mutex;
+    size_t slabs = 0;
+
+    central_pool() {}
+
+    char* new_slab() {
+        char* slab = static_cast<char*>(::operator new(slab_size));
+        std::lock_guard<std::mutex> lock(slab_mutex);
+        ++slabs;
+        return slab;
+    }
+};
+
+// Списки свободных блоков одного потока
+class thread_cache {
+public:
+    void* allocate(size_t size_class) {
+        free_block* block = heads[size_class];
+        if (block == nullptr) {
+            block = central_pool::instance().take(size_class, counts[size_class]);
+        }
+        heads[size_class] = block->next;
+        --counts[size_class];
+        return block;
+    }
+
+    void deallocate(void* pointer, size_t size_class) {
+        free_block* block = static_cast<free_block*>(pointer);
+        block->next = heads[size_class];
+        heads[size_class] = block;
+        // Поток, который только освобождает чужие объекты, не копит их бесконечно
+        if (++counts[size_class] >= 2 * batch_size(size_class)) {
+            release(size_class, batch_size(size_class));
+        }
+    }
+
+    // Вернуть все блоки в общий пул (при завершении потока)
+    void flush() {
+        for (size_t i = 0; i < class_count; ++i) {
+            if (counts[i] > 0) release(i, counts[i]);
+        }
+    }
+
+private:
+    free_block* heads[class_count] = {};
+    size_t counts[class_count] = {};
+
+    void release(size_t size_class, size_t count) {
+        free_block* head = heads[size_class];
+        free_block* last = head;
+        for (size_t i = 1; i < count; ++i) last = last->next;
+        heads[size_class] = last->next;
+        last->next = nullptr;
+        counts[size_class] -= count;
+        central_pool::instance().give(size_class, head, count);
+    }
+};
+
+// После разрушения кэша потока (деструкторы thread_local при выходе из
+// потока) блоки идут напрямую в общий пул
+inline thread_local bool cache_destroyed = false;
+
+struct cache_holder {
+    thread_cache cache;
+    ~cache_holder() {
+        cache.flush();
+        cache_destroyed = true;
+    }
+};
+
+inline thread_cache* local_cache() {
+    if (cache_destroyed) return nullptr;
+    static thread_local cache_holder holder;
+    return &holder.cache;
+}
+
+inline void* allocate(size_t size) {
+    if (size > max_block_size) return ::operator new(size);
+    const size_t size_class = class_of(size);
+    if (thread_cache* cache = local_cache()) return cache->allocate(size_class);
+    return ::operator new(block_size(size_class));
+}
+
+inline void deallocate(void* pointer, size_t size) {
+    if (size > max_block_size) {
+        ::operator delete(pointer);
+        return;
+    }
+    const size_t size_class = class_of(size);
+    if (thread_cache* cache = local_cache()) {
+        cache->deallocate(pointer, size_class);
+    } else {
+        free_block* block = static_cast<free_block*>(pointer);
+        block->next = nullptr;
+        central_pool::instance().give(size_class, block, 1);
+    }
+}
+
+} // namespace pool_detail
+
+template <typename T>
+class pooled {
+public:
+    static void* operator new(size_t size) {
+        static_assert(alignof(T) <= pool_detail::granularity, "pooled<T> blocks are only 16-byte aligned");
+        void* pointer = pool_detail::allocate(size);
+        T::on_pool_allocate(size);
+        return pointer;
+    }
+
+    // Размер приходит от компилятора: у наследника с виртуальным деструктором — его собственный
+    static void operator delete(void* pointer, size_t size) noexcept {
+        if (pointer == nullptr) return;
+        T::on_pool_release(size);
+        pool_detail::deallocate(pointer, size);
+    }
+
+    // Свой operator new скрывает глобальный размещающий, поэтому он повторён здесь
+    static void* operator new(size_t, void* place) noexcept {
+        return place;
+    }
+
+    static void operator delete(void*, void*) noexcept {}
+
+    // Хуки статистики по умолчанию; T может объявить свои с теми же именами
+    static void on_pool_allocate(size_t) {}
+    static void on_pool_release(size_t) {}
+
+    static pool_detail::pool_stats pool_statistics() {
+        return pool_detail::central_pool::instance().stats();
+    }
+};
+
 // Пример использования
-class Number : public less_than_comparable<Number>, public counter<Number> {
+class Number : public less_than_comparable<Number>, public counter<Number>, public pooled<Number> {
 public:
     Number(int value) : m_value{value} {}
 
+    // Хуки pooled: сколько байт занимают Number, созданные через new
+    static void on_pool_allocate(size_t size) { s_pooledBytes += size; }
+    static void on_pool_release(size_t size) { s_pooledBytes -= size; }
+    static size_t pooledBytes() { return s_pooledBytes; }
+
     int value() const {
         return m_value;
     }
@@ -68,9 +338,138 @@ public:
 
 private:
     int m_value;
+    inline static size_t s_pooledBytes = 0;
+};
+
+// Замеры производительности: ./hw_prod4 --bench
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Без пула, для сравнения: обычные new/delete
+template <typename T>
+class plain_new {};
+
+// Как узел выражения Constant: полиморфный объект с одним числом
+template <template <typename> class Allocation>
+class ConstantNode : public Allocation<ConstantNode<Allocation>> {
+public:
+    explicit ConstantNode(double value) : value(value) {}
+    virtual ~ConstantNode() {}
+    virtual double calculate() const { return value; }
+
+private:
+    double value;
+};
+
+// Как запись User: несколько полей без виртуальных функций
+template <template <typename> class Allocation>
+class UserRecord : public Allocation<UserRecord<Allocation>> {
+public:
+    UserRecord(int id, double balance) : id(id), name{'u', 's', 'e', 'r'}, balance(balance) {}
+
+    double getBalance() const { return balance; }
+
+private:
+    int id;
+    char name[28];
+    double balance;
 };
 
-int main() {
+// Каждый поток держит window живых объектов и раз за разом заменяет случайный;
+// возвращает миллионы пар new/delete в секунду
+template <typename Object>
+static double churn(size_t threadCount, size_t operations, size_t window) {
+    std::vector<std::thread> threads;
+    std::vector<double> sums(threadCount);
+    auto start = Clock::now();
+    for (size_t t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&sums, t, operations, window] {
+            std::mt19937 rng(static_cast<unsigned>(t) + 1);
+            std::vector<Object*> live(window);
+            for (size_t i = 0; i < window; ++i) live[i] = new Object(static_cast<int>(i), 1.0);
+            double sum = 0.0;
+            for (size_t i = 0; i < operations; ++i) {
+                size_t slot = rng() % window;
+                sum += live[slot]->getBalance();
+                delete live[slot];
+                live[slot] = new Object(static_cast<int>(i), static_cast<double>(i % 7));
+            }
+            for (Object* object : live) delete object;
+            sums[t] = sum;
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    return static_cast<double>(threadCount * operations) / elapsedMs(start) / 1000.0;
+}
+
+// Объекты создаются в одном потоке, а удаляются в другом (как при передаче
+// узлов между производителем и потребителем); миллионы пар в секунду
+template <typename Object>
+static double handOff(size_t threadCount, size_t rounds, size_t batch) {
+    std::vector<std::vector<Object*>> batches(threadCount, std::vector<Object*>(batch, nullptr));
+    auto start = Clock::now();
+    for (size_t round = 0; round < rounds; ++round) {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&batches, t, threadCount, round] {
+                // Пачку, заполненную в прошлом раунде другим потоком, освобождаем и заполняем заново
+                for (Object*& object : batches[(t + round) % threadCount]) {
+                    delete object;
+                    object = new Object(static_cast<int>(t), 1.0);
+                }
+            });
+        }
+        for (std::thread& thread : threads) thread.join();
+    }
+    for (auto& objects : batches) {
+        for (Object* object : objects) delete object;
+    }
+    return static_cast<double>(rounds * threadCount * batch) / elapsedMs(start) / 1000.0;
+}
+
+// Адаптер к churn/handOff для узла, у которого нет баланса
+template <template <typename> class Allocation>
+class ConstantChurn : public ConstantNode<Allocation> {
+public:
+    ConstantChurn(int, double value) : ConstantNode<Allocation>(value) {}
+    double getBalance() const { return this->calculate(); }
+};
+
+static void benchPooled() {
+    const size_t operations = 4000000;
+    const size_t window = 100000;
+    std::cout << "== pooled<T> против обычного new/delete (ядер: " << std::thread::hardware_concurrency() << ")"
+              << std::endl;
+    for (size_t threads : {size_t(1), size_t(2), size_t(4), size_t(8)}) {
+        double plainConstant = churn<ConstantChurn<plain_new>>(threads, operations / threads, window);
+        double pooledConstant = churn<ConstantChurn<pooled>>(threads, operations / threads, window);
+        double plainUser = churn<UserRecord<plain_new>>(threads, operations / threads, window);
+        double pooledUser = churn<UserRecord<pooled>>(threads, operations / threads, window);
+        std::cout << "  потоков " << threads << ": Constant (" << sizeof(ConstantChurn<pooled>) << " байт) "
+                  << plainConstant << " -> " << pooledConstant << " млн/с, User (" << sizeof(UserRecord<pooled>)
+                  << " байт) " << plainUser << " -> " << pooledUser << " млн/с" << std::endl;
+    }
+    for (size_t threads : {size_t(2), size_t(4)}) {
+        double plain = handOff<UserRecord<plain_new>>(threads, 40, 50000);
+        double pooledRate = handOff<UserRecord<pooled>>(threads, 40, 50000);
+        std::cout << "  удаление в другом потоке, потоков " << threads << ": User " << plain << " -> " << pooledRate
+                  << " млн/с" << std::endl;
+    }
+    pool_detail::pool_stats stats = pooled<Number>::pool_statistics();
+    std::cout << "  пул: slab " << stats.slabs << " (" << stats.reserved_bytes / 1024 << " КБ), пачек выдано "
+              << stats.refills << ", возвращено " << stats.returns << ", свободных блоков в общем пуле "
+              << stats.pooled_blocks << std::endl;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        benchPooled();
+        return 0;
+    }
+
     Number one{1};
     Number two{2};
     Number three{3};
@@ -81,5 +480,11 @@ int main() {
     assert(three > two);
     assert(one < two);
     std::cout << "Count: " << counter<Number>::count() << std::endl;
+
+    Number* five = new Number{5};
+    assert(*five > four);
+    std::cout << "Pooled bytes: " << Number::pooledBytes() << std::endl;
+    delete five;
+    assert(Number::pooledBytes() == 0);
     return 0;
 }
\ No newline at end of file
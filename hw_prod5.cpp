@@ -2,6 +2,568 @@
 #include <iostream>
 #include <ctime>
 #include <iomanip>
+#include <sstream>
+#include <atomic>
+#include <algorithm>
+#include <mutex>
+#include <new>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Формат файла самописца:
+//
+//     [FlightRecorderLayout, 64 байта]
+//     ringCount раз: [FlightRecorderRing, 64 байта][ringCapacity записей по 128 байт]
+//
+// Запись в ячейку защищена номером (stamp), как seqlock: поток-владелец
+// сначала обнуляет номер, потом пишет данные, потом ставит номер записи + 1.
+// Читатель принимает ячейку, только если номер до и после чтения совпадает
+// с ожидаемым, поэтому недописанные ячейки (поток упал посреди записи или
+// пишет прямо сейчас) пропускаются.
+struct FlightRecorderEntry {
+    std::atomic<uint64_t> stamp;  // номер записи + 1; 0 — ячейка пишется
+    int64_t time;                 // CLOCK_REALTIME, нс
+    uint32_t thread;              // идентификатор потока в системе
+    uint8_t level;
+    uint8_t length;
+    char text[FlightRecorder::textCapacity];
+};
+
+static_assert(sizeof(FlightRecorderEntry) == 128, "FlightRecorderEntry must fill two cache lines");
+
+struct alignas(64) FlightRecorderRing {
+    std::atomic<uint64_t> head;    // записей в кольце за всё время
+    std::atomic<uint32_t> owner;   // поток, который пишет в кольцо; 0 — свободно
+};
+
+struct alignas(64) FlightRecorderLayout {
+    char magic[8];
+    uint32_t version;
+    uint32_t ringCount;
+    uint32_t ringCapacity;         // степень двойки
+    uint32_t entrySize;
+    int64_t utcOffset;             // местное время − UTC, с
+    int64_t pid;
+    std::atomic<uint64_t> dropped;
+};
+
+namespace {
+
+const char flightRecorderMagic[8] = { 'F', 'L', 'I', 'G', 'H', 'T', 'R', 'C' };
+const uint32_t flightRecorderVersion = 1;
+const size_t maxRings = 256;
+
+size_t ringStride(size_t capacity) {
+    return sizeof(FlightRecorderRing) + capacity * sizeof(FlightRecorderEntry);
+}
+
+size_t regionSize(size_t ringCount, size_t capacity) {
+    return sizeof(FlightRecorderLayout) + ringCount * ringStride(capacity);
+}
+
+FlightRecorderRing* ringAt(const FlightRecorderLayout* layout, size_t index) {
+    const char* base = reinterpret_cast<const char*>(layout) + sizeof(FlightRecorderLayout);
+    return reinterpret_cast<FlightRecorderRing*>(const_cast<char*>(base + index * ringStride(layout->ringCapacity)));
+}
+
+FlightRecorderEntry* entriesOf(FlightRecorderRing* ring) {
+    return reinterpret_cast<FlightRecorderEntry*>(ring + 1);
+}
+
+// Живые самописцы: поток при завершении освобождает кольцо, только если
+// самописец ещё не разрушен
+std::mutex& registryMutex() {
+    static std::mutex mutex;
+    return mutex;
+}
+
+std::vector<uint64_t>& liveGenerations() {
+    static std::vector<uint64_t> generations;
+    return generations;
+}
+
+bool isLive(uint64_t generation) {
+    const std::vector<uint64_t>& live = liveGenerations();
+    for (uint64_t g : live) {
+        if (g == generation) return true;
+    }
+    return false;
+}
+
+std::atomic<uint64_t> nextGeneration{1};
+
+// Кольцо, которое занял поток
+struct ThreadSlot {
+    uint64_t generation = 0;
+    FlightRecorderRing* ring = nullptr;
+    FlightRecorderEntry* entries = nullptr;
+    uint64_t mask = 0;
+    uint32_t thread = 0;
+
+    void release() {
+        if (ring != nullptr && isLive(generation)) ring->owner.store(0, std::memory_order_release);
+        ring = nullptr;
+        generation = 0;
+    }
+
+    ~ThreadSlot() {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        release();
+    }
+};
+
+thread_local ThreadSlot threadSlot;
+
+// Вывод без выделения памяти и без stdio: только write(2)
+class LineWriter {
+private:
+    int fd;
+    char buffer[256];
+    size_t used = 0;
+
+public:
+    explicit LineWriter(int fd) : fd(fd) {}
+
+    void text(const char* data, size_t length) {
+        for (size_t i = 0; i < length; ++i) {
+            if (used == sizeof(buffer)) flush();
+            buffer[used++] = data[i];
+        }
+    }
+
+    void text(const char* data) { text(data, std::strlen(data)); }
+
+    void number(uint64_t value, int width = 0) {
+        char digits[20];
+        int count = 0;
+        do {
+            digits[count++] = static_cast<char>('0' + value % 10);
+            value /= 10;
+        } while (value != 0);
+        for (int i = count; i < width; ++i) text("0", 1);
+        while (count > 0) text(&digits[--count], 1);
+    }
+
+    void flush() {
+        size_t offset = 0;
+        while (offset < used) {
+            ssize_t written = ::write(fd, buffer + offset, used - offset);
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                break;
+            }
+            offset += static_cast<size_t>(written);
+        }
+        used = 0;
+    }
+};
+
+const char* levelName(uint8_t level) {
+    switch (level) {
+        case LOG_NORMAL: return "NORMAL";
+        case LOG_WARNING: return "WARNING";
+        case LOG_ERROR: return "ERROR";
+    }
+    return "?";
+}
+
+// Дата по числу дней от 1970-01-01 без localtime (не async-signal-safe)
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned dayOfEra = static_cast<unsigned>(days - era * 146097);
+    const unsigned yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    const unsigned dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    const unsigned shifted = (5 * dayOfYear + 2) / 153;
+    day = dayOfYear - (153 * shifted + 2) / 5 + 1;
+    month = shifted < 10 ? shifted + 3 : shifted - 9;
+    year = static_cast<int64_t>(yearOfEra) + era * 400 + (month <= 2);
+}
+
+// В формате Log::print: "ERROR: 19/10/2026 13:17:34.123456 [потока]: текст"
+void writeEntry(LineWriter& out, const FlightRecorderEntry& entry, int64_t utcOffset) {
+    int64_t seconds = entry.time / 1000000000 + utcOffset;
+    int64_t days = (seconds >= 0 ? seconds : seconds - 86399) / 86400;
+    int64_t secondOfDay = seconds - days * 86400;
+    int64_t year;
+    unsigned month;
+    unsigned day;
+    civilFromDays(days, year, month, day);
+
+    out.text(levelName(entry.level));
+    out.text(": ");
+    out.number(day, 2);
+    out.text("/");
+    out.number(month, 2);
+    out.text("/");
+    out.number(static_cast<uint64_t>(year));
+    out.text(" ");
+    out.number(static_cast<uint64_t>(secondOfDay / 3600), 2);
+    out.text(":");
+    out.number(static_cast<uint64_t>(secondOfDay / 60 % 60), 2);
+    out.text(":");
+    out.number(static_cast<uint64_t>(secondOfDay % 60), 2);
+    out.text(".");
+    out.number(static_cast<uint64_t>(entry.time % 1000000000 / 1000), 6);
+    out.text(" [");
+    out.number(entry.thread);
+    out.text("]: ");
+    out.text(entry.text, std::min<size_t>(entry.length, FlightRecorder::textCapacity));
+    out.text("\n");
+    out.flush();
+}
+
+// Копирование коротких строк блоками фиксированного размера с перекрытием:
+// memcpy переменной длины GCC разворачивает в rep movsq, а его запуск
+// дороже всей остальной записи в кольцо
+void copyText(char* to, const char* from, size_t length) {
+    if (length >= 16) {
+        for (size_t i = 0; i + 16 < length; i += 16) std::memcpy(to + i, from + i, 16);
+        std::memcpy(to + length - 16, from + length - 16, 16);
+    } else if (length >= 8) {
+        std::memcpy(to, from, 8);
+        std::memcpy(to + length - 8, from + length - 8, 8);
+    } else {
+        for (size_t i = 0; i < length; ++i) to[i] = from[i];
+    }
+}
+
+// Копия ячейки position кольца, если она дописана и не перезаписана
+bool readEntry(FlightRecorderRing* ring, uint64_t mask, uint64_t position, FlightRecorderEntry& copy) {
+    const FlightRecorderEntry& entry = entriesOf(ring)[position & mask];
+    uint64_t before = entry.stamp.load(std::memory_order_acquire);
+    if (before != position + 1) return false;
+    copy.time = entry.time;
+    copy.thread = entry.thread;
+    copy.level = entry.level;
+    copy.length = entry.length;
+    std::memcpy(copy.text, entry.text, sizeof(copy.text));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return entry.stamp.load(std::memory_order_relaxed) == before;
+}
+
+// Слияние колец по времени: последние maxEntries записей, от старых к новым.
+// Память только на стеке, размер ограничен maxRings
+size_t dumpRegion(const FlightRecorderLayout* layout, size_t length, int fd, size_t maxEntries) {
+    if (length < sizeof(FlightRecorderLayout) ||
+        std::memcmp(layout->magic, flightRecorderMagic, sizeof(flightRecorderMagic)) != 0 ||
+        layout->version != flightRecorderVersion || layout->entrySize != sizeof(FlightRecorderEntry) ||
+        layout->ringCount == 0 || layout->ringCount > maxRings || layout->ringCapacity == 0 ||
+        (layout->ringCapacity & (layout->ringCapacity - 1)) != 0 ||
+        length < regionSize(layout->ringCount, layout->ringCapacity)) {
+        return 0;
+    }
+
+    const size_t ringCount = layout->ringCount;
+    const uint64_t capacity = layout->ringCapacity;
+    const uint64_t mask = capacity - 1;
+    uint64_t heads[maxRings];
+    uint64_t lows[maxRings];
+    uint64_t cursors[maxRings];
+    for (size_t r = 0; r < ringCount; ++r) {
+        heads[r] = ringAt(layout, r)->head.load(std::memory_order_acquire);
+        lows[r] = heads[r] > capacity ? heads[r] - capacity : 0;
+        cursors[r] = heads[r];
+    }
+
+    // Назад от самых новых: где начинаются последние maxEntries записей
+    FlightRecorderEntry entry;
+    size_t selected = 0;
+    while (selected < maxEntries) {
+        size_t best = ringCount;
+        int64_t bestTime = 0;
+        for (size_t r = 0; r < ringCount; ++r) {
+            while (cursors[r] > lows[r] && !readEntry(ringAt(layout, r), mask, cursors[r] - 1, entry)) --cursors[r];
+            if (cursors[r] > lows[r] && (best == ringCount || entry.time > bestTime)) {
+                best = r;
+                bestTime = entry.time;
+            }
+        }
+        if (best == ringCount) break;
+        --cursors[best];
+        ++selected;
+    }
+
+    // Вперёд: вывод по возрастанию времени
+    LineWriter out(fd);
+    size_t written = 0;
+    while (written < selected) {
+        size_t best = ringCount;
+        int64_t bestTime = 0;
+        for (size_t r = 0; r < ringCount; ++r) {
+            while (cursors[r] < heads[r] && !readEntry(ringAt(layout, r), mask, cursors[r], entry)) ++cursors[r];
+            if (cursors[r] < heads[r] && (best == ringCount || entry.time < bestTime)) {
+                best = r;
+                bestTime = entry.time;
+            }
+        }
+        if (best == ringCount) break;
+        if (readEntry(ringAt(layout, best), mask, cursors[best], entry)) {
+            writeEntry(out, entry, layout->utcOffset);
+            ++written;
+        }
+        ++cursors[best];
+    }
+    return written;
+}
+
+// Обработчики аварийных сигналов
+const int crashSignals[] = { SIGSEGV, SIGABRT, SIGBUS, SIGFPE, SIGILL };
+const size_t crashDumpEntries = 256;
+std::atomic<FlightRecorder*> crashRecorder{nullptr};
+struct sigaction previousActions[sizeof(crashSignals) / sizeof(crashSignals[0])];
+bool handlersInstalled = false;
+void* alternateStack = nullptr;
+
+const char* signalName(int signal) {
+    switch (signal) {
+        case SIGSEGV: return "SIGSEGV";
+        case SIGABRT: return "SIGABRT";
+        case SIGBUS: return "SIGBUS";
+        case SIGFPE: return "SIGFPE";
+        case SIGILL: return "SIGILL";
+    }
+    return "signal";
+}
+
+void crashHandler(int signal, siginfo_t* info, void*) {
+    int savedErrno = errno;
+    FlightRecorder* recorder = crashRecorder.exchange(nullptr);
+    if (recorder != nullptr) {
+        LineWriter out(STDERR_FILENO);
+        out.text("*** ");
+        out.text(signalName(signal));
+        out.text(": last log entries (flight recorder ");
+        out.text(recorder->getPath().c_str());
+        out.text(")\n");
+        out.flush();
+        recorder->dump(STDERR_FILENO, crashDumpEntries);
+    }
+
+    // Дальше сигнал обрабатывает то, что стояло до самописца (отчёт о
+    // падении, санитайзер), или действие по умолчанию
+    for (size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i) {
+        if (crashSignals[i] == signal) ::sigaction(signal, &previousActions[i], nullptr);
+    }
+    errno = savedErrno;
+    // Сигнал от kill, raise или abort повторяется явно. Аппаратная ошибка
+    // повторится сама: после выхода инструкция выполнится снова, и прежний
+    // обработчик получит настоящий siginfo с адресом ошибки
+    if (info == nullptr || info->si_code <= 0) ::raise(signal);
+}
+
+void installCrashHandlers(FlightRecorder* recorder) {
+    crashRecorder.store(recorder);
+    if (handlersInstalled) return;
+
+    // Отдельный стек, чтобы дамп работал и при переполнении стека. Выделяется
+    // один раз и ставится потоку, первым включившему обработчики: sigaltstack
+    // действует на поток, а общий стек у двух потоков испортился бы при
+    // одновременном падении. Повторные включения его не перевыделяют.
+    const size_t stackSize = 64 * 1024;
+    if (alternateStack == nullptr) {
+        alternateStack = std::malloc(stackSize);
+        if (alternateStack != nullptr) {
+            stack_t stack;
+            stack.ss_sp = alternateStack;
+            stack.ss_size = stackSize;
+            stack.ss_flags = 0;
+            ::sigaltstack(&stack, nullptr);
+        }
+    }
+
+    struct sigaction action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_sigaction = crashHandler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_SIGINFO | SA_RESETHAND | SA_ONSTACK;
+    for (size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i) {
+        ::sigaction(crashSignals[i], &action, &previousActions[i]);
+    }
+    handlersInstalled = true;
+}
+
+// Альтернативный стек остаётся: его поток может быть не тем, что выключает
+// обработчики, и следующее включение использует его снова
+void removeCrashHandlers() {
+    crashRecorder.store(nullptr);
+    if (!handlersInstalled) return;
+    for (size_t i = 0; i < sizeof(crashSignals) / sizeof(crashSignals[0]); ++i) {
+        ::sigaction(crashSignals[i], &previousActions[i], nullptr);
+    }
+    handlersInstalled = false;
+}
+
+} // namespace
+
+const size_t FlightRecorder::textCapacity;
+
+FlightRecorder::FlightRecorder(const std::string& path, size_t maxThreads, size_t entriesPerThread)
+    : path(path), layout(nullptr), length(0), generation(nextGeneration.fetch_add(1)) {
+    if (maxThreads == 0 || maxThreads > maxRings) {
+        throw std::invalid_argument("FlightRecorder: maxThreads must be in [1, " + std::to_string(maxRings) + "]");
+    }
+    if (entriesPerThread == 0 || entriesPerThread > (size_t(1) << 20)) {
+        throw std::invalid_argument("FlightRecorder: entriesPerThread must be in [1, 1048576]");
+    }
+    size_t capacity = 1;
+    while (capacity < entriesPerThread) capacity *= 2;
+
+    // Записи прошлого запуска (возможно, аварийного) не затираются: старый
+    // файл переименовывается в path.prev, где его можно прочитать dumpFile()
+    struct stat existing;
+    if (::stat(path.c_str(), &existing) == 0 && existing.st_size > 0) {
+        const std::string previous = previousPath(path);
+        if (::rename(path.c_str(), previous.c_str()) != 0) {
+            throw std::runtime_error("Cannot rotate flight recorder file '" + path + "' to '" + previous +
+                                     "': " + std::strerror(errno));
+        }
+    }
+
+    int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create flight recorder file '" + path + "': " + std::strerror(errno));
+    }
+    length = regionSize(maxThreads, capacity);
+    if (::ftruncate(fd, static_cast<off_t>(length)) != 0) {
+        int error = errno;
+        ::close(fd);
+        throw std::runtime_error("Cannot size flight recorder file '" + path + "': " + std::strerror(error));
+    }
+    void* mapped = ::mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    int error = errno;
+    ::close(fd);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map flight recorder file '" + path + "': " + std::strerror(error));
+    }
+
+    // Файл только что обнулён; атомарные поля создаются на месте
+    layout = new (mapped) FlightRecorderLayout();
+    layout->version = flightRecorderVersion;
+    layout->ringCount = static_cast<uint32_t>(maxThreads);
+    layout->ringCapacity = static_cast<uint32_t>(capacity);
+    layout->entrySize = sizeof(FlightRecorderEntry);
+    time_t now = time(0);
+    tm local;
+    localtime_r(&now, &local);
+    layout->utcOffset = local.tm_gmtoff;
+    layout->pid = ::getpid();
+    layout->dropped.store(0);
+    for (size_t r = 0; r < maxThreads; ++r) {
+        FlightRecorderRing* ring = new (ringAt(layout, r)) FlightRecorderRing();
+        ring->head.store(0);
+        ring->owner.store(0);
+        FlightRecorderEntry* entries = entriesOf(ring);
+        for (size_t i = 0; i < capacity; ++i) new (&entries[i].stamp) std::atomic<uint64_t>(0);
+    }
+    // Заголовок последним: файл без него не считается самописцем
+    std::memcpy(layout->magic, flightRecorderMagic, sizeof(flightRecorderMagic));
+
+    std::lock_guard<std::mutex> lock(registryMutex());
+    liveGenerations().push_back(generation);
+}
+
+FlightRecorder::~FlightRecorder() {
+    {
+        std::lock_guard<std::mutex> lock(registryMutex());
+        std::vector<uint64_t>& live = liveGenerations();
+        for (size_t i = 0; i < live.size(); ++i) {
+            if (live[i] == generation) {
+                live.erase(live.begin() + i);
+                break;
+            }
+        }
+    }
+    if (crashRecorder.load() == this) removeCrashHandlers();
+    ::munmap(layout, length);
+}
+
+void FlightRecorder::record(LogLevel level, const char* text, size_t textLength) {
+    ThreadSlot& slot = threadSlot;
+    if (slot.generation != generation) {
+        // Первая запись потока: занять свободное кольцо (редкий путь, под мьютексом)
+        std::lock_guard<std::mutex> lock(registryMutex());
+        slot.release();
+        if (slot.thread == 0) slot.thread = static_cast<uint32_t>(::syscall(SYS_gettid));
+        // Сначала нетронутые кольца, чтобы записи завершившихся потоков
+        // перезаписывались как можно позже
+        for (size_t r = 0; r < 2 * layout->ringCount && slot.ring == nullptr; ++r) {
+            FlightRecorderRing* ring = ringAt(layout, r % layout->ringCount);
+            bool unused = ring->head.load(std::memory_order_relaxed) == 0;
+            uint32_t expected = 0;
+            if ((unused || r >= layout->ringCount) && ring->owner.load(std::memory_order_relaxed) == 0 &&
+                ring->owner.compare_exchange_strong(expected, slot.thread, std::memory_order_acquire)) {
+                slot.ring = ring;
+                slot.entries = entriesOf(ring);
+                slot.mask = layout->ringCapacity - 1;
+                slot.generation = generation;
+                break;
+            }
+        }
+        if (slot.ring == nullptr) {
+            layout->dropped.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    timespec now;
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    FlightRecorderRing* ring = slot.ring;
+    const uint64_t position = ring->head.load(std::memory_order_relaxed);
+    FlightRecorderEntry& entry = slot.entries[position & slot.mask];
+    entry.stamp.store(0, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    entry.time = static_cast<int64_t>(now.tv_sec) * 1000000000 + now.tv_nsec;
+    entry.thread = slot.thread;
+    entry.level = static_cast<uint8_t>(level);
+    size_t length = std::min(textLength, textCapacity);
+    entry.length = static_cast<uint8_t>(length);
+    copyText(entry.text, text, length);
+    entry.stamp.store(position + 1, std::memory_order_release);
+    ring->head.store(position + 1, std::memory_order_release);
+}
+
+size_t FlightRecorder::dump(int fd, size_t maxEntries) const {
+    return dumpRegion(layout, length, fd, maxEntries);
+}
+
+size_t FlightRecorder::dumpFile(const std::string& path, int fd, size_t maxEntries) {
+    int file = ::open(path.c_str(), O_RDONLY);
+    if (file < 0) {
+        throw std::runtime_error("Cannot open flight recorder file '" + path + "': " + std::strerror(errno));
+    }
+    struct stat st;
+    if (::fstat(file, &st) != 0 || st.st_size < static_cast<off_t>(sizeof(FlightRecorderLayout))) {
+        ::close(file);
+        throw std::runtime_error("Flight recorder file '" + path + "' is too short");
+    }
+    size_t fileLength = static_cast<size_t>(st.st_size);
+    void* mapped = ::mmap(nullptr, fileLength, PROT_READ, MAP_SHARED, file, 0);
+    int error = errno;
+    ::close(file);
+    if (mapped == MAP_FAILED) {
+        throw std::runtime_error("Cannot map flight recorder file '" + path + "': " + std::strerror(error));
+    }
+    size_t written = dumpRegion(static_cast<const FlightRecorderLayout*>(mapped), fileLength, fd, maxEntries);
+    ::munmap(mapped, fileLength);
+    return written;
+}
+
+std::string FlightRecorder::previousPath(const std::string& path) {
+    return path + ".prev";
+}
+
+uint64_t FlightRecorder::dropped() const {
+    return layout->dropped.load(std::memory_order_relaxed);
+}
 
 Log* Log::Instance() {
     static Log instance;
@@ -9,6 +571,11 @@ Log* Log::Instance() {
 }
 
 void Log::message(LogLevel level, const std::string& message) {
+    if (recorder != nullptr) {
+        recorder->record(level, message.data(), message.size());
+        return;
+    }
+
     time_t now = time(0);
     tm* ltm = localtime(&now);
     std::stringstream ss;
@@ -26,7 +593,22 @@ void Log::message(LogLevel level, const std::string& message) {
     }
 }
 
+// Без временной std::string, чтобы самописец не выделял память на длинные строки
+void Log::message(LogLevel level, const char* message) {
+    if (recorder != nullptr) {
+        recorder->record(level, message, std::strlen(message));
+        return;
+    }
+    this->message(level, std::string(message));
+}
+
 void Log::print() const {
+    if (recorder != nullptr) {
+        std::cout.flush();
+        recorder->dump(STDOUT_FILENO, maxEntries);
+        return;
+    }
+
     for (const auto& entry : entries) {
         switch (entry.first) {
             case LOG_NORMAL:
@@ -41,4 +623,17 @@ void Log::print() const {
         }
         std::cout << entry.second << std::endl;
     }
-}
\ No newline at end of file
+}
+
+void Log::enableFlightRecorder(const std::string& path, size_t maxThreads, size_t entriesPerThread,
+                               bool installCrashHandlers) {
+    FlightRecorder* created = new FlightRecorder(path, maxThreads, entriesPerThread);
+    disableFlightRecorder();
+    recorder = created;
+    if (installCrashHandlers) ::installCrashHandlers(recorder);
+}
+
+void Log::disableFlightRecorder() {
+    delete recorder;
+    recorder = nullptr;
+}
@@ -4,6 +4,8 @@
 #include <iostream>
 #include <vector>
 #include <string>
+#include <cstddef>
+#include <cstdint>
 
 // Enum для уровней важности
 enum LogLevel {
@@ -12,17 +14,64 @@ enum LogLevel {
     LOG_ERROR
 };
 
+// Бортовой самописец: последние записи каждого потока в отображённом в память файле
+//
+// У каждого потока своё кольцо записей фиксированного размера, поэтому запись
+// не берёт блокировок и не выделяет память: время, уровень и текст (обрезанный
+// до textCapacity байт) копируются в очередную ячейку. Файл отображается с
+// MAP_SHARED, так что записи остаются в кэше страниц ядра и после аварийного
+// завершения процесса — их можно прочитать dumpFile(). dump() сливает кольца
+// по времени и выводит последние записи; он безопасен в обработчике сигнала.
+struct FlightRecorderLayout;
+
+class FlightRecorder {
+public:
+    static const size_t textCapacity = 100;
+
+    // Файл создаётся заново, а прежний (от прошлого запуска) переименовывается
+    // в previousPath(path); maxThreads — сколько потоков могут писать одновременно
+    FlightRecorder(const std::string& path, size_t maxThreads, size_t entriesPerThread);
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    // Без блокировок и выделения памяти; из любого потока
+    void record(LogLevel level, const char* text, size_t length);
+
+    // Последние maxEntries записей всех потоков по времени в дескриптор fd.
+    // Только async-signal-safe вызовы (write), без выделения памяти
+    size_t dump(int fd, size_t maxEntries) const;
+
+    // То же для файла, оставшегося от завершившегося процесса
+    static size_t dumpFile(const std::string& path, int fd, size_t maxEntries);
+
+    // Куда конструктор убирает файл прошлого запуска: path + ".prev"
+    static std::string previousPath(const std::string& path);
+
+    // Записи, потерянные из-за того, что все кольца заняты потоками
+    uint64_t dropped() const;
+    const std::string& getPath() const { return path; }
+
+private:
+    std::string path;
+    FlightRecorderLayout* layout;
+    size_t length;
+    uint64_t generation;  // отличает этот самописец от прежних в кэше потоков
+};
+
 // Класс Log (Singleton)
 class Log {
 private:
     std::vector<std::pair<LogLevel, std::string>> entries;
     const size_t maxEntries = 10;
+    FlightRecorder* recorder = nullptr;
 
     // Приватный конструктор (для Singleton)
     Log() {}
 
     // Приватный деструктор (для Singleton)
-    ~Log() {}
+    ~Log() { disableFlightRecorder(); }
 
     // Удаляем конструктор копирования и оператор присваивания, чтобы запретить копирование
     Log(const Log&) = delete;
@@ -34,9 +83,21 @@ public:
 
     // Метод для записи сообщения в лог
     void message(LogLevel level, const std::string& message);
+    void message(LogLevel level, const char* message);
 
     // Метод для вывода последних записей лога
     void print() const;
+
+    // Режим бортового самописца: сообщения пишутся в кольца потоков в файле
+    // path (десятки наносекунд на сообщение, можно из нескольких потоков), а при
+    // SIGSEGV, SIGABRT, SIGBUS, SIGFPE и SIGILL последние записи выводятся в
+    // stderr, после чего сигнал получает прежний обработчик (или действие по
+    // умолчанию). Отключать, когда другие потоки уже не пишут в лог
+    void enableFlightRecorder(const std::string& path, size_t maxThreads = 64, size_t entriesPerThread = 1024,
+                              bool installCrashHandlers = true);
+    void disableFlightRecorder();
+    bool flightRecorderEnabled() const { return recorder != nullptr; }
+    const FlightRecorder* flightRecorder() const { return recorder; }
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,123 @@
+#include "hw_prod5.h"
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fcntl.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// Замеры бортового самописца Log:
+//     g++ -std=c++17 -O2 -pthread hw_prod5.cpp hw_prod5_bench.cpp && ./a.out
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static const char* recorderPath = "hw_prod5_bench.flight";
+
+// Наносекунд на сообщение, когда threads потоков пишут по perThread сообщений
+static double nsPerMessage(size_t threads, size_t perThread) {
+    Log* log = Log::Instance();
+    auto start = Clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([log, perThread] {
+            for (size_t i = 0; i < perThread; ++i) log->message(LOG_NORMAL, "Request processed by worker");
+        });
+    }
+    for (std::thread& worker : workers) worker.join();
+    return elapsedMs(start) * 1e6 / static_cast<double>(threads * perThread);
+}
+
+static void benchMessage() {
+    Log* log = Log::Instance();
+    std::cout << "== Стоимость Log::message" << std::endl;
+
+    // Прежний путь: localtime, stringstream и сдвиг вектора — только из одного потока
+    double plainNs = nsPerMessage(1, 200000);
+    std::cout << "Обычный режим, 1 поток: " << plainNs << " нс/сообщение" << std::endl;
+
+    log->enableFlightRecorder(recorderPath, 64, 4096, false);
+    nsPerMessage(1, 100000);  // прогрев: страницы файла и кольцо потока
+    for (size_t threads : {size_t(1), size_t(4)}) {
+        double flightNs = nsPerMessage(threads, 2000000 / threads);
+        std::cout << "Самописец, " << threads << " поток(а): " << flightNs << " нс/сообщение" << std::endl;
+    }
+
+    const int dumps = 100;
+    int devNull = ::open("/dev/null", O_WRONLY);
+    auto start = Clock::now();
+    size_t written = 0;
+    for (int i = 0; i < dumps; ++i) written = log->flightRecorder()->dump(devNull, 256);
+    std::cout << "dump последних " << written << " записей из 64 колец: " << elapsedMs(start) / dumps << " мс"
+              << std::endl;
+    ::close(devNull);
+    log->disableFlightRecorder();
+}
+
+// Дочерний процесс пишет в лог из двух потоков и падает по SIGSEGV;
+// родитель проверяет, что обработчик вывел записи и что они есть в файле
+static void crashDemo() {
+    std::cout << "\n== Падение процесса" << std::endl;
+    const char* stderrPath = "hw_prod5_bench.stderr";
+    pid_t child = ::fork();
+    if (child < 0) {
+        std::perror("fork");
+        return;
+    }
+    if (child == 0) {
+        int fd = ::open(stderrPath, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        ::dup2(fd, STDERR_FILENO);
+        ::close(fd);
+        Log* log = Log::Instance();
+        log->enableFlightRecorder(recorderPath, 8, 64);
+        std::thread worker([log] {
+            for (int i = 0; i < 100; ++i) log->message(LOG_WARNING, "worker step " + std::to_string(i));
+        });
+        worker.join();
+        log->message(LOG_NORMAL, "Opening course file");
+        log->message(LOG_ERROR, "About to dereference a null pointer");
+        volatile int* pointer = nullptr;
+        *pointer = 1;
+        std::_Exit(0);
+    }
+
+    int status = 0;
+    ::waitpid(child, &status, 0);
+    std::ifstream in(stderrPath);
+    std::stringstream captured;
+    captured << in.rdbuf();
+    std::string text = captured.str();
+    size_t lines = 0;
+    for (char c : text) lines += c == '\n';
+    std::cout << "Процесс завершён сигналом " << (WIFSIGNALED(status) ? WTERMSIG(status) : 0) << ", в stderr "
+              << lines << " строк, последняя:" << std::endl;
+    size_t lastLine = text.rfind('\n', text.size() >= 2 ? text.size() - 2 : 0);
+    std::cout << "  " << text.substr(lastLine == std::string::npos ? 0 : lastLine + 1);
+
+    // Перезапуск: новый самописец на том же пути не затирает записи упавшего процесса
+    Log::Instance()->enableFlightRecorder(recorderPath, 8, 64, false);
+    Log::Instance()->message(LOG_NORMAL, "Restarted");
+    const std::string previous = FlightRecorder::previousPath(recorderPath);
+    std::cout << "После перезапуска, последние записи из " << previous << ":" << std::endl;
+    std::cout.flush();
+    FlightRecorder::dumpFile(previous, STDOUT_FILENO, 3);
+    Log::Instance()->disableFlightRecorder();
+    std::remove(stderrPath);
+    std::remove(recorderPath);
+    std::remove(previous.c_str());
+}
+
+int main() {
+    benchMessage();
+    crashDemo();
+    return 0;
+}
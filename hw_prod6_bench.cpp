@@ -0,0 +1,421 @@
+#include "check_point6.h"
+#include "concrete_build6.h"
+#include "spatial_index6.h"
+#include "check_point_table6.h"
+#include "course_reader6.h"
+#include "route_solver6.h"
+#include <iostream>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <string>
+#include <limits>
+#include <memory>
+#include <fstream>
+#include <cstdio>
+#include <sys/resource.h>
+
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+// Случайные КП в прямоугольнике, покрывающем европейскую часть России
+static std::vector<CheckPoint> makeCheckPoints(size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<double> lat(54.0, 62.0);
+    std::uniform_real_distribution<double> lon(30.0, 40.0);
+    std::vector<CheckPoint> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.emplace_back("КП" + std::to_string(i + 1), lat(rng), lon(rng), CheckPoint::Type::MANDATORY);
+    }
+    return result;
+}
+
+static std::vector<SpatialIndexBuilder::Fix> makeFixes(size_t count, std::mt19937& rng) {
+    std::uniform_real_distribution<double> lat(54.0, 62.0);
+    std::uniform_real_distribution<double> lon(30.0, 40.0);
+    std::vector<SpatialIndexBuilder::Fix> result;
+    result.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        result.push_back({lat(rng), lon(rng)});
+    }
+    return result;
+}
+
+static void benchSpatialIndex() {
+    const size_t checkPointCount = 50000;
+    const size_t fixCount = 2000;
+    const double radiusKm = 5.0;
+
+    std::mt19937 rng(42);
+    std::vector<CheckPoint> checkPoints = makeCheckPoints(checkPointCount, rng);
+    std::vector<SpatialIndexBuilder::Fix> fixes = makeFixes(fixCount, rng);
+
+    std::cout << "== Пространственный индекс: " << checkPointCount << " КП, "
+              << fixCount << " отметок\n";
+
+    // Полный перебор по формуле гаверсинусов
+    auto start = Clock::now();
+    std::vector<size_t> bruteNearest(fixCount);
+    size_t bruteRadiusHits = 0;
+    for (size_t f = 0; f < fixCount; ++f) {
+        double best = std::numeric_limits<double>::infinity();
+        for (size_t i = 0; i < checkPointCount; ++i) {
+            double d = haversineDistance(fixes[f].first, fixes[f].second,
+                                         checkPoints[i].getLatitude(), checkPoints[i].getLongitude());
+            if (d < best) {
+                best = d;
+                bruteNearest[f] = i;
+            }
+            if (d <= radiusKm) ++bruteRadiusHits;
+        }
+    }
+    double bruteMs = elapsedMs(start);
+
+    SpatialIndexBuilder indexBuilder;
+    start = Clock::now();
+    for (const auto& cp : checkPoints) {
+        indexBuilder.addCheckPoint(cp);
+    }
+    indexBuilder.build();
+    double buildMs = elapsedMs(start);
+
+    start = Clock::now();
+    std::vector<size_t> indexNearest = indexBuilder.nearest(fixes);
+    double nearestMs = elapsedMs(start);
+
+    start = Clock::now();
+    size_t indexRadiusHits = 0;
+    for (const auto& hits : indexBuilder.withinRadius(fixes, radiusKm)) {
+        indexRadiusHits += hits.size();
+    }
+    double radiusMs = elapsedMs(start);
+
+    size_t mismatches = 0;
+    for (size_t f = 0; f < fixCount; ++f) {
+        if (bruteNearest[f] != indexNearest[f]) ++mismatches;
+    }
+
+    std::cout << "Перебор (ближайший + радиус): " << bruteMs << " мс\n";
+    std::cout << "Построение индекса: " << buildMs << " мс\n";
+    std::cout << "Индекс, ближайший: " << nearestMs << " мс\n";
+    std::cout << "Индекс, радиус " << radiusKm << " км: " << radiusMs << " мс\n";
+    std::cout << "Расхождений ближайшего: " << mismatches
+              << ", попаданий в радиус: " << indexRadiusHits << " / " << bruteRadiusHits << "\n\n";
+}
+
+static void benchCheckPointTable() {
+    const size_t checkPointCount = 1000000;
+
+    std::mt19937 rng(7);
+    std::uniform_real_distribution<double> lat(54.0, 62.0);
+    std::uniform_real_distribution<double> lon(30.0, 40.0);
+    std::uniform_real_distribution<double> penalty(0.5, 3.0);
+
+    // Исходное представление: полиморфные объекты в куче
+    std::vector<std::unique_ptr<CheckPoint>> owned;
+    std::vector<CheckPoint*> checkPoints;
+    owned.reserve(checkPointCount);
+    checkPoints.reserve(checkPointCount);
+    for (size_t i = 0; i < checkPointCount; ++i) {
+        std::string name = "КП" + std::to_string(i + 1);
+        if (i % 3 == 0) {
+            owned.emplace_back(new OptionalCheckPoint(name, lat(rng), lon(rng), penalty(rng)));
+        } else {
+            owned.emplace_back(new CheckPoint(name, lat(rng), lon(rng), CheckPoint::Type::MANDATORY));
+        }
+        checkPoints.push_back(owned.back().get());
+    }
+
+    std::cout << "== CheckPointTable против виртуальных вызовов: " << checkPointCount << " КП\n";
+
+    auto start = Clock::now();
+    CheckPointTableBuilder tableBuilder;
+    tableBuilder.reserve(checkPointCount);
+    for (const auto& cp : checkPoints) {
+        tableBuilder.addCheckPoint(*cp);
+    }
+    CheckPointTable table = tableBuilder.takeTable();
+    std::cout << "Перекладка в таблицу: " << elapsedMs(start) << " мс\n";
+
+    start = Clock::now();
+    PenaltyCalculatorBuilder penaltyBuilder;
+    for (const auto& cp : checkPoints) {
+        penaltyBuilder.addCheckPoint(*cp);
+    }
+    double virtualPenalty = penaltyBuilder.getTotalPenalty();
+    double virtualPenaltyMs = elapsedMs(start);
+
+    start = Clock::now();
+    double tablePenalty = table.totalPenalty();
+    double tablePenaltyMs = elapsedMs(start);
+
+    start = Clock::now();
+    double virtualRoute = 0.0;
+    for (size_t i = 1; i < checkPoints.size(); ++i) {
+        virtualRoute += haversineDistance(checkPoints[i - 1]->getLatitude(), checkPoints[i - 1]->getLongitude(),
+                                          checkPoints[i]->getLatitude(), checkPoints[i]->getLongitude());
+    }
+    double virtualRouteMs = elapsedMs(start);
+
+    start = Clock::now();
+    double tableRoute = table.routeLength();
+    double tableRouteMs = elapsedMs(start);
+
+    start = Clock::now();
+    std::vector<double> virtualDistances(checkPoints.size());
+    for (size_t i = 0; i < checkPoints.size(); ++i) {
+        virtualDistances[i] = haversineDistance(55.75, 37.62, checkPoints[i]->getLatitude(), checkPoints[i]->getLongitude());
+    }
+    double virtualDistMs = elapsedMs(start);
+
+    start = Clock::now();
+    std::vector<double> tableDistances = table.distancesFrom(55.75, 37.62);
+    double tableDistMs = elapsedMs(start);
+
+    double maxDiff = 0.0;
+    for (size_t i = 0; i < checkPoints.size(); ++i) {
+        maxDiff = std::max(maxDiff, std::abs(virtualDistances[i] - tableDistances[i]));
+    }
+
+    std::cout << "Суммарный штраф: " << virtualPenaltyMs << " мс -> " << tablePenaltyMs << " мс ("
+              << virtualPenalty << " / " << tablePenalty << ")\n";
+    std::cout << "Длина маршрута: " << virtualRouteMs << " мс -> " << tableRouteMs << " мс ("
+              << virtualRoute << " / " << tableRoute << " км)\n";
+    std::cout << "Расстояния от точки: " << virtualDistMs << " мс -> " << tableDistMs
+              << " мс (макс. расхождение " << maxDiff << " км)\n\n";
+}
+
+static void benchDirector() {
+    const size_t checkPointCount = 1000000;
+
+    std::mt19937 rng(11);
+    std::uniform_real_distribution<double> lat(54.0, 62.0);
+    std::uniform_real_distribution<double> lon(30.0, 40.0);
+    std::uniform_real_distribution<double> penalty(0.5, 3.0);
+
+    std::vector<std::unique_ptr<CheckPoint>> owned;
+    std::vector<CheckPoint*> checkPoints;
+    owned.reserve(checkPointCount);
+    checkPoints.reserve(checkPointCount);
+    for (size_t i = 0; i < checkPointCount; ++i) {
+        std::string name = "КП" + std::to_string(i + 1);
+        if (i % 3 == 0) {
+            owned.emplace_back(new OptionalCheckPoint(name, lat(rng), lon(rng), penalty(rng)));
+        } else {
+            owned.emplace_back(new CheckPoint(name, lat(rng), lon(rng), CheckPoint::Type::MANDATORY));
+        }
+        checkPoints.push_back(owned.back().get());
+    }
+
+    std::cout << "== Director: " << checkPointCount << " КП, 3 builder'а\n";
+
+    // Отдельный проход для каждого builder'а
+    TextListBuilder textBuilder;
+    PenaltyCalculatorBuilder penaltyBuilder;
+    CheckPointTableBuilder tableBuilder;
+    auto start = Clock::now();
+    for (const auto& cp : checkPoints) textBuilder.addCheckPoint(*cp);
+    for (const auto& cp : checkPoints) penaltyBuilder.addCheckPoint(*cp);
+    for (const auto& cp : checkPoints) tableBuilder.addCheckPoint(*cp);
+    std::cout << "Несколько проходов: " << elapsedMs(start) << " мс\n";
+    std::string expectedText = textBuilder.getTextList();
+    double expectedPenalty = penaltyBuilder.getTotalPenalty();
+
+    std::vector<size_t> threadCounts = {1, 4};
+    size_t hardwareThreads = std::thread::hardware_concurrency();
+    if (hardwareThreads > 4) threadCounts.push_back(hardwareThreads);
+    for (size_t threadCount : threadCounts) {
+        textBuilder.reset();
+        penaltyBuilder.reset();
+        tableBuilder.reset();
+
+        CheckPointListDirector director;
+        director.addBuilder(&textBuilder);
+        director.addBuilder(&penaltyBuilder);
+        director.addBuilder(&tableBuilder);
+        director.setThreadCount(threadCount);
+
+        start = Clock::now();
+        director.construct(checkPoints);
+        double ms = elapsedMs(start);
+
+        bool same = textBuilder.getTextList() == expectedText &&
+                    std::abs(penaltyBuilder.getTotalPenalty() - expectedPenalty) < 1e-6 * expectedPenalty &&
+                    tableBuilder.getTable().size() == checkPointCount;
+        std::cout << "Один проход, потоков " << threadCount << ": " << ms << " мс"
+                  << (same ? "" : " (результат отличается!)") << "\n";
+    }
+    std::cout << "\n";
+}
+
+// Прежняя реализация TextListBuilder для сравнения
+class ConcatTextListBuilder : public CheckPointListBuilder {
+private:
+    std::string textList;
+    int checkpoint_counter = 0;
+
+public:
+    void reset() override {
+        textList = "";
+        checkpoint_counter = 0;
+    }
+
+    void addCheckPoint(const CheckPoint& checkPoint) override {
+        checkpoint_counter++;
+        textList += std::to_string(checkpoint_counter) + ". ";
+        textList += checkPoint.getName() + ", ";
+        textList += "Latitude: " + std::to_string(checkPoint.getLatitude()) + ", ";
+        textList += "Longitude: " + std::to_string(checkPoint.getLongitude()) + ", ";
+
+        if (checkPoint.getType() == CheckPoint::Type::OPTIONAL) {
+            textList += "Penalty: " + std::to_string(checkPoint.getPenalty()) + "\n";
+        } else {
+            textList += "Не зачёт СУ\n";
+        }
+    }
+
+    std::string getTextList() const { return textList; }
+};
+
+static void benchTextListBuilder() {
+    const size_t checkPointCount = 1000000;
+
+    std::mt19937 rng(5);
+    std::uniform_real_distribution<double> lat(54.0, 62.0);
+    std::uniform_real_distribution<double> lon(30.0, 40.0);
+    std::vector<std::unique_ptr<CheckPoint>> checkPoints;
+    checkPoints.reserve(checkPointCount);
+    for (size_t i = 0; i < checkPointCount; ++i) {
+        std::string name = "КП" + std::to_string(i + 1);
+        if (i % 3 == 0) {
+            checkPoints.emplace_back(new OptionalCheckPoint(name, lat(rng), lon(rng), 1.5));
+        } else {
+            checkPoints.emplace_back(new CheckPoint(name, lat(rng), lon(rng), CheckPoint::Type::MANDATORY));
+        }
+    }
+
+    std::cout << "== TextListBuilder: " << checkPointCount << " КП\n";
+
+    auto start = Clock::now();
+    ConcatTextListBuilder concatBuilder;
+    for (const auto& cp : checkPoints) concatBuilder.addCheckPoint(*cp);
+    std::string expected = concatBuilder.getTextList();
+    std::cout << "Конкатенация временных строк: " << elapsedMs(start) << " мс\n";
+
+    start = Clock::now();
+    TextListBuilder textBuilder;
+    textBuilder.reserve(expected.size());
+    for (const auto& cp : checkPoints) textBuilder.addCheckPoint(*cp);
+    std::string text = textBuilder.takeTextList();
+    std::cout << "to_chars в зарезервированный буфер: " << elapsedMs(start) << " мс"
+              << (text == expected ? "" : " (текст отличается!)") << "\n";
+
+    start = Clock::now();
+    std::ofstream devNull("/dev/null");
+    TextListBuilder streamBuilder(devNull);
+    for (const auto& cp : checkPoints) streamBuilder.addCheckPoint(*cp);
+    streamBuilder.flush();
+    std::cout << "to_chars с выводом в поток: " << elapsedMs(start) << " мс\n\n";
+}
+
+static void benchRouteSolver() {
+    std::cout << "== Оптимизация маршрута (скорость 60 км/ч)\n";
+
+    for (size_t checkPointCount : {size_t(20), size_t(200), size_t(2000)}) {
+        std::mt19937 rng(13);
+        std::uniform_real_distribution<double> lat(55.0, 56.0);
+        std::uniform_real_distribution<double> lon(37.0, 39.0);
+        std::uniform_real_distribution<double> penalty(0.1, 1.0);
+
+        RouteSolverBuilder routeBuilder;
+        for (size_t i = 0; i < checkPointCount; ++i) {
+            std::string name = "КП" + std::to_string(i + 1);
+            if (i % 3 == 1) {
+                routeBuilder.addCheckPoint(OptionalCheckPoint(name, lat(rng), lon(rng), penalty(rng)));
+            } else {
+                routeBuilder.addCheckPoint(CheckPoint(name, lat(rng), lon(rng), CheckPoint::Type::MANDATORY));
+            }
+        }
+        routeBuilder.setRestarts(8);
+        routeBuilder.setThreadCount(std::max<size_t>(1, std::thread::hardware_concurrency()));
+
+        auto start = Clock::now();
+        RouteSolverBuilder::Route greedy = routeBuilder.solveGreedy();
+        double greedyMs = elapsedMs(start);
+
+        routeBuilder.setExactLimit(0);
+        start = Clock::now();
+        RouteSolverBuilder::Route heuristic = routeBuilder.solve();
+        double heuristicMs = elapsedMs(start);
+
+        std::cout << checkPointCount << " КП: жадный " << greedy.totalHours << " ч (" << greedyMs << " мс), "
+                  << "локальный поиск " << heuristic.totalHours << " ч (" << heuristicMs << " мс, пропущено "
+                  << heuristic.skipped.size() << ")";
+
+        if (checkPointCount <= 20) {
+            routeBuilder.setExactLimit(20);
+            start = Clock::now();
+            RouteSolverBuilder::Route exact = routeBuilder.solve();
+            double exactMs = elapsedMs(start);
+            std::cout << ", точно " << exact.totalHours << " ч (" << exactMs << " мс)";
+        }
+        std::cout << "\n";
+    }
+    std::cout << "\n";
+}
+
+// Пиковый RSS процесса, МБ
+static double peakRssMb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss / 1024.0;
+}
+
+static void benchCourseReader() {
+    const size_t rowCount = 5000000;
+    const std::string path = "/tmp/hw_prod6_course_bench.csv";
+
+    {
+        std::mt19937 rng(3);
+        std::uniform_real_distribution<double> lat(54.0, 62.0);
+        std::uniform_real_distribution<double> lon(30.0, 40.0);
+        std::ofstream out(path);
+        out << "name,latitude,longitude,penalty\n";
+        for (size_t i = 0; i < rowCount; ++i) {
+            out << "КП" << (i + 1) << ',' << lat(rng) << ',' << lon(rng) << ',';
+            if (i % 3 == 0) out << 1.5;
+            out << '\n';
+        }
+    }
+
+    std::cout << "== Потоковое чтение файла дистанции: " << rowCount << " строк\n";
+    double rssBefore = peakRssMb();
+
+    CourseFileReader reader(path);
+    PenaltyCalculatorBuilder penaltyBuilder;
+    auto start = Clock::now();
+    size_t count = reader.read(penaltyBuilder);
+    double ms = elapsedMs(start);
+
+    double sizeMb = reader.size() / (1024.0 * 1024.0);
+    std::cout << "Файл: " << sizeMb << " МБ, КП: " << count << ", суммарный штраф: "
+              << penaltyBuilder.getTotalPenalty() << "\n";
+    std::cout << "Время: " << ms << " мс, " << sizeMb / (ms / 1000.0) << " МБ/с\n";
+    std::cout << "Пиковый RSS: до " << rssBefore << " МБ, после " << peakRssMb() << " МБ\n\n";
+
+    std::remove(path.c_str());
+}
+
+int main() {
+    // Чтение файла идёт первым, чтобы пиковый RSS не включал остальные замеры
+    benchCourseReader();
+    benchSpatialIndex();
+    benchCheckPointTable();
+    benchDirector();
+    benchTextListBuilder();
+    benchRouteSolver();
+    return 0;
+}
@@ -1,5 +1,7 @@
 #include "check_point6.h"
 #include "concrete_build6.h"
+#include "spatial_index6.h"
+#include "route_solver6.h"
 #include <iostream>
 #include <vector>
 
@@ -12,27 +14,45 @@ int main() {
 
     std::vector<CheckPoint*> checkPoints = {&cp1, &cp2, &cp3, &cp4};
 
-    // 1. Вывод списка КП в текстовом виде
+    // Один проход по списку КП для всех builder'ов
     TextListBuilder textBuilder;
-    CheckPointListDirector director;
-    director.setBuilder(&textBuilder);
+    PenaltyCalculatorBuilder penaltyBuilder;
+    SpatialIndexBuilder indexBuilder;
+    RouteSolverBuilder routeBuilder;
 
-    for (const auto& cp : checkPoints) {
-        textBuilder.addCheckPoint(*cp);
-    }
+    CheckPointListDirector director;
+    director.addBuilder(&textBuilder);
+    director.addBuilder(&penaltyBuilder);
+    director.addBuilder(&indexBuilder);
+    director.addBuilder(&routeBuilder);
+    director.construct(checkPoints);
 
+    // 1. Вывод списка КП в текстовом виде
     std::cout << "Список КП:\n" << textBuilder.getTextList() << std::endl;
 
     // 2. Подсчёт суммарного штрафа
-    PenaltyCalculatorBuilder penaltyBuilder;
-    director.setBuilder(&penaltyBuilder);
-    penaltyBuilder.reset();
+    std::cout << "Суммарный штраф: " << penaltyBuilder.getTotalPenalty() << " часов\n";
 
-    for (const auto& cp : checkPoints) {
-        penaltyBuilder.addCheckPoint(*cp);
-    }
+    // 3. Поиск ближайшего КП и КП в радиусе
+    indexBuilder.build();
+    size_t nearestId = indexBuilder.nearest(55.0, 37.0);
+    std::cout << "Ближайший КП к (55.0, 37.0): " << indexBuilder.getName(nearestId) << std::endl;
 
-    std::cout << "Суммарный штраф: " << penaltyBuilder.getTotalPenalty() << " часов\n";
+    std::cout << "КП в радиусе 200 км от (55.0, 37.0):";
+    for (size_t id : indexBuilder.withinRadius(55.0, 37.0, 200.0)) {
+        std::cout << " " << indexBuilder.getName(id);
+    }
+    std::cout << std::endl;
+
+    // 4. Порядок объезда КП
+    routeBuilder.setSpeed(100.0);
+    RouteSolverBuilder::Route route = routeBuilder.solve();
+    std::cout << "Маршрут:";
+    for (size_t id : route.order) {
+        std::cout << " " << routeBuilder.getName(id);
+    }
+    std::cout << "\nПропущено КП: " << route.skipped.size() << ", в пути " << route.distanceKm << " км, итого "
+              << route.totalHours << " часов" << std::endl;
 
     return 0;
-}
\ No newline at end of file
+}
@@ -2,9 +2,52 @@
 #include <vector>
 #include <set>
 #include <unordered_set>
+#include <algorithm>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+#include <string>
+#include <random>
+#include <chrono>
+#include <iterator>
+#include <limits>
+#include <cmath>
+#include <variant>
+#include <functional>
+#include <new>
+#include <utility>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+#include <memory>
+#include <istream>
+#include <fstream>
+#include <charconv>
+#include <cctype>
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 class SetImpl {
 public:
+    enum Kind {
+        ARRAY,
+        FLAT,
+        HASH,
+        BITMAP,
+        ROARING,
+        FILTERED,
+        MAPPED
+    };
+
     virtual ~SetImpl() {}
     virtual void add(int element) = 0;
     virtual void remove(int element) = 0;
@@ -13,8 +56,44 @@ public:
     virtual size_t size() const = 0;
     virtual SetImpl* clone() const = 0;
 
+    virtual Kind kind() const = 0;
+    // Можно ли добавить элемент без смены реализации
+    virtual bool canHold(int) const { return true; }
+    // Примерный объём занимаемой памяти, байт
+    virtual size_t memoryUsage() const = 0;
+
+    // toVector() возвращает элементы по возрастанию
+    virtual bool isSorted() const { return false; }
+    // Непрерывный отсортированный массив из size() элементов, если реализация
+    // хранит элементы так; иначе nullptr и нужен toVector()
+    virtual const int* sortedElements() const { return nullptr; }
+    // Реализация только для чтения: add и remove недоступны
+    virtual bool isReadOnly() const { return false; }
+    // Пакетное добавление; реализации переопределяют его, если могут быстрее поэлементного
+    virtual void addAll(const std::vector<int>& elements) {
+        for (int element : elements) add(element);
+    }
+
+    // Перенос не более maxCount элементов в target без промежуточных копий;
+    // перенесённые элементы удаляются. Возвращает число перенесённых элементов
+    virtual size_t drainInto(SetImpl& target, size_t maxCount) = 0;
+    // Наименьший и наибольший элементы; false для пустого множества
+    virtual bool bounds(int& low, int& high) const = 0;
 };
 
+const char* kindName(SetImpl::Kind kind) {
+    switch (kind) {
+        case SetImpl::ARRAY: return "ArraySet";
+        case SetImpl::FLAT: return "FlatSet";
+        case SetImpl::HASH: return "HashSet";
+        case SetImpl::BITMAP: return "BitmapSet";
+        case SetImpl::ROARING: return "RoaringSet";
+        case SetImpl::FILTERED: return "FilteredSet";
+        case SetImpl::MAPPED: return "MappedSet";
+    }
+    return "unknown";
+}
+
 // ArraySet
 class ArraySet : public SetImpl {
 private:
@@ -44,6 +123,26 @@ public:
     std::vector<int> toVector() const override { return data; }
     size_t size() const override { return data.size(); }
     SetImpl* clone() const override { return new ArraySet(*this); }
+
+    Kind kind() const override { return ARRAY; }
+    bool canHold(int) const override { return data.size() < maxSize; }
+    size_t memoryUsage() const override { return sizeof(*this) + data.capacity() * sizeof(int); }
+
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = 0;
+        for (; moved < maxCount && !data.empty(); ++moved) {
+            target.add(data.back());
+            data.pop_back();
+        }
+        return moved;
+    }
+    bool bounds(int& low, int& high) const override {
+        if (data.empty()) return false;
+        auto range = std::minmax_element(data.begin(), data.end());
+        low = *range.first;
+        high = *range.second;
+        return true;
+    }
 };
 
 // b. HashSet (for large number of elements)
@@ -60,81 +159,2782 @@ public:
     }
     size_t size() const override { return data.size(); }
     SetImpl* clone() const override { return new HashSet(*this); }
+
+    Kind kind() const override { return HASH; }
+    void addAll(const std::vector<int>& elements) override {
+        data.reserve(data.size() + elements.size());
+        data.insert(elements.begin(), elements.end());
+    }
+    size_t memoryUsage() const override {
+        // Узел списка (указатель + значение) и служебные байты malloc на элемент, плюс массив корзин
+        return sizeof(*this) + data.bucket_count() * sizeof(void*) + data.size() * 32;
+    }
+
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = 0;
+        for (; moved < maxCount && !data.empty(); ++moved) {
+            auto it = data.begin();
+            target.add(*it);
+            data.erase(it);
+        }
+        return moved;
+    }
+    bool bounds(int& low, int& high) const override {
+        if (data.empty()) return false;
+        auto range = std::minmax_element(data.begin(), data.end());
+        low = *range.first;
+        high = *range.second;
+        return true;
+    }
 };
 
-// 3. Абстракция (Bridge Abstraction)
-class Set {
-protected:
-    SetImpl* impl;
-    size_t threshold; // Threshold for switching implementations
+// Индекс первого элемента отсортированного массива, не меньшего element.
+// Вместо ветвления на каждом шаге — условная пересылка указателя.
+size_t lowerBoundBranchless(const int* data, size_t n, int element) {
+    if (n == 0) return 0;
+    const int* base = data;
+    while (n > 1) {
+        size_t half = n / 2;
+        base = (base[half] < element) ? base + half : base;
+        n -= half;
+    }
+    return static_cast<size_t>(base - data) + (*base < element);
+}
+
+// c. FlatSet: отсортированный массив, поиск без ветвлений
+class FlatSet : public SetImpl {
+private:
+    std::vector<int> data;
+
+    size_t lowerBound(int element) const {
+        return lowerBoundBranchless(data.data(), data.size(), element);
+    }
 
 public:
-    Set(SetImpl* impl, size_t threshold) : impl(impl), threshold(threshold) {}
-    virtual ~Set() { delete impl; }
+    FlatSet() {}
 
-    void add(int element) {
-        if (!impl->contains(element)) {
-            impl->add(element);
-            switchImplementationIfNeeded();
+    // Из уже отсортированных элементов без повторов
+    explicit FlatSet(std::vector<int>&& sorted) : data(std::move(sorted)) {}
+
+    void add(int element) override {
+        size_t i = lowerBound(element);
+        if (i == data.size() || data[i] != element) {
+            data.insert(data.begin() + i, element);
         }
     }
+    void remove(int element) override {
+        size_t i = lowerBound(element);
+        if (i < data.size() && data[i] == element) {
+            data.erase(data.begin() + i);
+        }
+    }
+    bool contains(int element) const override {
+        size_t i = lowerBound(element);
+        return i < data.size() && data[i] == element;
+    }
+    std::vector<int> toVector() const override { return data; }
+    size_t size() const override { return data.size(); }
+    SetImpl* clone() const override { return new FlatSet(*this); }
 
-    void remove(int element) {
-        impl->remove(element);
-        switchImplementationIfNeeded();
+    bool isSorted() const override { return true; }
+    const int* sortedElements() const override { return data.data(); }
+    void addAll(const std::vector<int>& elements) override {
+        size_t middle = data.size();
+        data.insert(data.end(), elements.begin(), elements.end());
+        std::sort(data.begin() + middle, data.end());
+        std::inplace_merge(data.begin(), data.begin() + middle, data.end());
+        data.erase(std::unique(data.begin(), data.end()), data.end());
+    }
+
+    Kind kind() const override { return FLAT; }
+    size_t memoryUsage() const override { return sizeof(*this) + data.capacity() * sizeof(int); }
+
+    // С конца массива, чтобы не сдвигать оставшиеся элементы
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = 0;
+        for (; moved < maxCount && !data.empty(); ++moved) {
+            target.add(data.back());
+            data.pop_back();
+        }
+        return moved;
     }
+    bool bounds(int& low, int& high) const override {
+        if (data.empty()) return false;
+        low = data.front();
+        high = data.back();
+        return true;
+    }
+};
 
-    bool contains(int element) const { return impl->contains(element); }
-    size_t size() const { return impl->size(); }
+// d. BitmapSet: битовая карта для элементов из ограниченного диапазона [minValue, maxValue]
+class BitmapSet : public SetImpl {
+private:
+    std::vector<uint64_t> words;
+    int64_t base;
+    int64_t limit;
+    size_t count = 0;
+    size_t topWord = 0;  // выше этого слова единичных битов нет; подсказка для drainInto
+
+    bool inRange(int element) const { return element >= base && element <= limit; }
+
+public:
+    // Начало диапазона выравнивается вниз до кратного 64, чтобы слова
+    // разных карт совпадали и операции над ними шли целыми словами
+    BitmapSet(int minValue, int maxValue) {
+        base = minValue >= 0 ? (int64_t(minValue) / 64) * 64 : -((-int64_t(minValue) + 63) / 64) * 64;
+        int64_t last = maxValue < minValue ? base - 1 : int64_t(maxValue);
+        words.assign(static_cast<size_t>((last - base + 1 + 63) / 64), 0);
+        limit = base + static_cast<int64_t>(words.size()) * 64 - 1;
+        topWord = words.empty() ? 0 : words.size() - 1;
+    }
 
-    std::vector<int> toVector() const { return impl->toVector(); }
+    enum Operation {
+        AND,
+        OR,
+        AND_NOT,
+        XOR
+    };
 
-    Set* unite(const Set& other) const {
-        Set* newSet = new Set(impl->clone(), threshold);
-        for (int element : other.toVector()) {
-            newSet->add(element);
+    // Пословная операция над двумя картами
+    static BitmapSet* combine(const BitmapSet& a, const BitmapSet& b, Operation op) {
+        int64_t low;
+        int64_t high;
+        if (op == AND) {
+            low = std::max(a.base, b.base);
+            high = std::min(a.limit, b.limit);
+        } else if (op == AND_NOT) {
+            low = a.base;
+            high = a.limit;
+        } else {
+            low = std::min(a.base, b.base);
+            high = std::max(a.limit, b.limit);
         }
-        for (int element : this->toVector()) {
-             newSet->add(element);
+        if (high < low) {
+            return new BitmapSet(0, -1);
         }
-        return newSet;
+
+        BitmapSet* result = new BitmapSet(static_cast<int>(low), static_cast<int>(std::min<int64_t>(high, INT32_MAX)));
+        size_t n = result->words.size();
+        int64_t aShift = (result->base - a.base) / 64;
+        int64_t bShift = (result->base - b.base) / 64;
+        size_t total = 0;
+        for (size_t w = 0; w < n; ++w) {
+            int64_t aw = aShift + static_cast<int64_t>(w);
+            int64_t bw = bShift + static_cast<int64_t>(w);
+            uint64_t x = (aw >= 0 && aw < static_cast<int64_t>(a.words.size())) ? a.words[aw] : 0;
+            uint64_t y = (bw >= 0 && bw < static_cast<int64_t>(b.words.size())) ? b.words[bw] : 0;
+            uint64_t word;
+            switch (op) {
+                case AND: word = x & y; break;
+                case OR: word = x | y; break;
+                case AND_NOT: word = x & ~y; break;
+                default: word = x ^ y; break;
+            }
+            result->words[w] = word;
+            total += static_cast<size_t>(__builtin_popcountll(word));
+        }
+        result->count = total;
+        return result;
+    }
+
+    void add(int element) override {
+        if (!inRange(element)) return;
+        uint64_t offset = static_cast<uint64_t>(element - base);
+        uint64_t& word = words[offset >> 6];
+        uint64_t bit = uint64_t(1) << (offset & 63);
+        count += (word & bit) == 0;
+        word |= bit;
+        topWord = std::max<size_t>(topWord, offset >> 6);
+    }
+    void remove(int element) override {
+        if (!inRange(element)) return;
+        uint64_t offset = static_cast<uint64_t>(element - base);
+        uint64_t& word = words[offset >> 6];
+        uint64_t bit = uint64_t(1) << (offset & 63);
+        count -= (word & bit) != 0;
+        word &= ~bit;
+    }
+    bool contains(int element) const override {
+        if (!inRange(element)) return false;
+        uint64_t offset = static_cast<uint64_t>(element - base);
+        return (words[offset >> 6] >> (offset & 63)) & 1;
     }
+    std::vector<int> toVector() const override {
+        std::vector<int> result;
+        result.reserve(count);
+        for (size_t w = 0; w < words.size(); ++w) {
+            uint64_t word = words[w];
+            while (word != 0) {
+                int bit = __builtin_ctzll(word);
+                result.push_back(static_cast<int>(base + static_cast<int64_t>(w * 64 + bit)));
+                word &= word - 1;
+            }
+        }
+        return result;
+    }
+    size_t size() const override { return count; }
+    SetImpl* clone() const override { return new BitmapSet(*this); }
+
+    Kind kind() const override { return BITMAP; }
+    bool isSorted() const override { return true; }
+    bool canHold(int element) const override { return inRange(element); }
+    size_t memoryUsage() const override { return sizeof(*this) + words.capacity() * sizeof(uint64_t); }
+
+    // Сверху вниз: пустые слова над topWord больше не просматриваются
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = 0;
+        while (moved < maxCount && count > 0) {
+            while (words[topWord] == 0) --topWord;
+            uint64_t& word = words[topWord];
+            int bit = 63 - __builtin_clzll(word);
+            target.add(static_cast<int>(base + static_cast<int64_t>(topWord * 64 + bit)));
+            word &= ~(uint64_t(1) << bit);
+            --count;
+            ++moved;
+        }
+        return moved;
+    }
+    bool bounds(int& low, int& high) const override {
+        if (count == 0) return false;
+        size_t first = 0;
+        while (words[first] == 0) ++first;
+        size_t last = words.size() - 1;
+        while (words[last] == 0) --last;
+        low = static_cast<int>(base + static_cast<int64_t>(first * 64 + __builtin_ctzll(words[first])));
+        high = static_cast<int>(base + static_cast<int64_t>(last * 64 + 63 - __builtin_clzll(words[last])));
+        return true;
+    }
+};
+
+// e. RoaringSet: сжатая битовая карта для больших разреженных множеств
+//
+// Значения делятся на блоки по старшим 16 битам. Блок хранит младшие 16 бит
+// либо отсортированным массивом (до arrayLimit элементов), либо битовой картой
+// на 65536 бит.
+class RoaringSet : public SetImpl {
+private:
+    static const size_t arrayLimit = 4096;
+    static const size_t bitmapWords = 65536 / 64;
+
+    struct Container {
+        uint16_t key;
+        uint32_t cardinality = 0;
+        std::vector<uint16_t> array;   // пока блок небольшой
+        std::vector<uint64_t> bitmap;  // после превышения arrayLimit
+
+        bool isBitmap() const { return !bitmap.empty(); }
+
+        bool contains(uint16_t low) const {
+            if (isBitmap()) return (bitmap[low >> 6] >> (low & 63)) & 1;
+            return std::binary_search(array.begin(), array.end(), low);
+        }
 
-    Set* intersect(const Set& other) const {
-        Set* newSet = new Set(impl->clone(), threshold);
-        for (int element : this->toVector()) {
-            if (other.contains(element)) {
-                newSet->add(element);
+        bool add(uint16_t low) {
+            if (isBitmap()) {
+                uint64_t& word = bitmap[low >> 6];
+                uint64_t bit = uint64_t(1) << (low & 63);
+                if (word & bit) return false;
+                word |= bit;
+                ++cardinality;
+                return true;
             }
+            if (array.empty() || array.back() < low) {
+                array.push_back(low);  // добавление по возрастанию — без поиска
+            } else {
+                auto it = std::lower_bound(array.begin(), array.end(), low);
+                if (*it == low) return false;
+                array.insert(it, low);
+            }
+            ++cardinality;
+            if (array.size() > arrayLimit) {
+                bitmap.assign(bitmapWords, 0);
+                for (uint16_t v : array) bitmap[v >> 6] |= uint64_t(1) << (v & 63);
+                std::vector<uint16_t>().swap(array);
+            }
+            return true;
         }
-        return newSet;
+
+        bool remove(uint16_t low) {
+            if (isBitmap()) {
+                uint64_t& word = bitmap[low >> 6];
+                uint64_t bit = uint64_t(1) << (low & 63);
+                if (!(word & bit)) return false;
+                word &= ~bit;
+                --cardinality;
+                // Обратно в массив с запасом, чтобы не переключаться на каждой операции
+                if (cardinality < arrayLimit / 2) {
+                    array.reserve(cardinality);
+                    appendTo(array);
+                    std::vector<uint64_t>().swap(bitmap);
+                }
+                return true;
+            }
+            auto it = std::lower_bound(array.begin(), array.end(), low);
+            if (it == array.end() || *it != low) return false;
+            array.erase(it);
+            --cardinality;
+            return true;
+        }
+
+        uint16_t minimum() const {
+            if (!isBitmap()) return array.front();
+            size_t w = 0;
+            while (bitmap[w] == 0) ++w;
+            return static_cast<uint16_t>(w * 64 + __builtin_ctzll(bitmap[w]));
+        }
+
+        uint16_t maximum() const {
+            if (!isBitmap()) return array.back();
+            size_t w = bitmap.size() - 1;
+            while (bitmap[w] == 0) --w;
+            return static_cast<uint16_t>(w * 64 + 63 - __builtin_clzll(bitmap[w]));
+        }
+
+        void appendTo(std::vector<uint16_t>& out) const {
+            for (size_t w = 0; w < bitmap.size(); ++w) {
+                uint64_t word = bitmap[w];
+                while (word != 0) {
+                    out.push_back(static_cast<uint16_t>(w * 64 + __builtin_ctzll(word)));
+                    word &= word - 1;
+                }
+            }
+        }
+    };
+
+    std::vector<Container> containers;  // по возрастанию key
+    size_t count = 0;
+
+    // Сдвиг на 2^31 сохраняет порядок: отрицательные числа идут раньше положительных
+    static uint32_t toUnsigned(int element) { return static_cast<uint32_t>(element) ^ 0x80000000u; }
+    static int toSigned(uint32_t value) { return static_cast<int>(value ^ 0x80000000u); }
+
+    std::vector<Container>::iterator findContainer(uint16_t key) {
+        return std::lower_bound(containers.begin(), containers.end(), key,
+                                [](const Container& c, uint16_t k) { return c.key < k; });
     }
 
-protected:
-    virtual void switchImplementationIfNeeded() {
-        if (impl->size() > threshold) {
-            std::cout << "Switching to HashSet implementation" << std::endl;
-            SetImpl* newImpl = new HashSet();
-            for (int element : impl->toVector()) {
-                newImpl->add(element);
+    std::vector<Container>::const_iterator findContainer(uint16_t key) const {
+        return std::lower_bound(containers.begin(), containers.end(), key,
+                                [](const Container& c, uint16_t k) { return c.key < k; });
+    }
+
+public:
+    void add(int element) override {
+        uint32_t value = toUnsigned(element);
+        uint16_t key = static_cast<uint16_t>(value >> 16);
+        // Добавление по возрастанию попадает в последний блок или в новый после него — без поиска
+        auto it = containers.empty() || containers.back().key < key ? containers.end()
+                  : containers.back().key == key ? containers.end() - 1
+                  : findContainer(key);
+        if (it == containers.end() || it->key != key) {
+            Container container;
+            container.key = key;
+            it = containers.insert(it, std::move(container));
+        }
+        count += it->add(static_cast<uint16_t>(value & 0xFFFF));
+    }
+    void remove(int element) override {
+        uint32_t value = toUnsigned(element);
+        uint16_t key = static_cast<uint16_t>(value >> 16);
+        auto it = findContainer(key);
+        if (it == containers.end() || it->key != key) return;
+        count -= it->remove(static_cast<uint16_t>(value & 0xFFFF));
+        if (it->cardinality == 0) {
+            containers.erase(it);
+        }
+    }
+    bool contains(int element) const override {
+        uint32_t value = toUnsigned(element);
+        uint16_t key = static_cast<uint16_t>(value >> 16);
+        auto it = findContainer(key);
+        return it != containers.end() && it->key == key && it->contains(static_cast<uint16_t>(value & 0xFFFF));
+    }
+    std::vector<int> toVector() const override {
+        std::vector<int> result;
+        result.reserve(count);
+        std::vector<uint16_t> lows;
+        for (const Container& c : containers) {
+            uint32_t high = static_cast<uint32_t>(c.key) << 16;
+            if (c.isBitmap()) {
+                lows.clear();
+                c.appendTo(lows);
+                for (uint16_t low : lows) result.push_back(toSigned(high | low));
+            } else {
+                for (uint16_t low : c.array) result.push_back(toSigned(high | low));
             }
-            delete impl;
-            impl = newImpl;
+        }
+        return result;
+    }
+    size_t size() const override { return count; }
+    SetImpl* clone() const override { return new RoaringSet(*this); }
+
+    Kind kind() const override { return ROARING; }
+    bool isSorted() const override { return true; }
+    size_t memoryUsage() const override {
+        size_t total = sizeof(*this) + containers.capacity() * sizeof(Container);
+        for (const Container& c : containers) {
+            total += c.array.capacity() * sizeof(uint16_t) + c.bitmap.capacity() * sizeof(uint64_t);
+        }
+        return total;
+    }
 
-        } else if (impl->size() < threshold / 2 && dynamic_cast<HashSet*>(impl) != nullptr) {
-            std::cout << "Switching back to ArraySet implementation" << std::endl;
-            ArraySet* newImpl = new ArraySet(threshold);
-            for (int element : impl->toVector()) {
-                newImpl->add(element);
+    // С последнего блока сверху вниз: блоки не сдвигаются, массивы укорачиваются с конца
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = 0;
+        while (moved < maxCount && !containers.empty()) {
+            Container& c = containers.back();
+            uint32_t high = static_cast<uint32_t>(c.key) << 16;
+            uint16_t low = c.maximum();
+            target.add(toSigned(high | low));
+            c.remove(low);
+            --count;
+            ++moved;
+            if (c.cardinality == 0) {
+                containers.pop_back();
             }
-            delete impl;
-            impl = newImpl;
         }
+        return moved;
+    }
+    bool bounds(int& low, int& high) const override {
+        if (containers.empty()) return false;
+        low = toSigned((static_cast<uint32_t>(containers.front().key) << 16) | containers.front().minimum());
+        high = toSigned((static_cast<uint32_t>(containers.back().key) << 16) | containers.back().maximum());
+        return true;
+    }
+};
+
+// f. FilteredSet: блочный фильтр Блума перед точным множеством
+//
+// Для поиска, который в основном промахивается. Элемент хэшируется в один
+// блок из 64 байт (одна кэш-линия) и ставит по одному биту в каждое из 8
+// слов блока, поэтому промах почти всегда отсекается чтением одной линии,
+// и только попадания и ложные срабатывания идут в точное множество.
+// Размер фильтра — bitsPerElement бит на каждый элемент при перестройке,
+// так что доля ложных срабатываний сразу после неё равна заданной. До
+// следующей перестройки можно добавить ещё четверть элементов; к её концу
+// доля вырастает примерно втрое (1% -> 2.8%). Биты удалённых элементов не
+// снимаются, а накапливаются, пока их не станет больше половины ёмкости —
+// тогда тоже перестройка.
+class FilteredSet : public SetImpl {
+private:
+    struct alignas(64) Block {
+        uint64_t words[8];
+    };
+
+    SetImpl* exact;
+    std::vector<Block> blocks;
+    double bitsPerElement;
+    size_t capacity = 0;   // элементов, на которые рассчитан фильтр
+    size_t inserted = 0;   // добавлено в фильтр с последней перестройки
+    size_t removed = 0;    // удалено из точного множества с последней перестройки
+
+    static uint64_t mix(int element) {
+        uint64_t h = static_cast<uint32_t>(element);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        return h ^ (h >> 33);
+    }
+
+    // Номер блока из старших 32 бит (умножение вместо деления по модулю), маски
+    // слов — из младших 32 бит, умноженных на нечётные «соли»
+    size_t blockOf(uint64_t h) const {
+        return static_cast<size_t>(((h >> 32) * blocks.size()) >> 32);
+    }
+
+    static uint64_t bitOf(uint64_t h, int word) {
+        static const uint32_t salts[8] = { 0x47B6137Bu, 0x44974D91u, 0x8824AD5Bu, 0xA2B7289Du,
+                                           0x705495C7u, 0x2DF1424Bu, 0x9EFC4947u, 0x5C6BFB31u };
+        return uint64_t(1) << ((static_cast<uint32_t>(h) * salts[word]) >> 26);
+    }
+
+    void insert(int element) {
+        uint64_t h = mix(element);
+        Block& block = blocks[blockOf(h)];
+        for (int w = 0; w < 8; ++w) block.words[w] |= bitOf(h, w);
+        ++inserted;
+    }
+
+    // Битовый массив — по фактическому числу элементов, чтобы доля ложных
+    // срабатываний сразу после перестройки была заданной. Запас на рост
+    // (capacity) только откладывает следующую перестройку
+    void rebuild() {
+        size_t count = std::max<size_t>(64, exact->size());
+        capacity = count + count / 4;
+        size_t bits = static_cast<size_t>(std::ceil(static_cast<double>(count) * bitsPerElement));
+        blocks.assign(std::max<size_t>(1, (bits + 511) / 512), Block());
+        inserted = 0;
+        removed = 0;
+        for (int element : exact->toVector()) insert(element);
+    }
+
+    void afterRemove(size_t count) {
+        removed += count;
+        if (removed > capacity / 2) rebuild();
+    }
+
+public:
+    // Доля ложных срабатываний при bitsPerElement битах на элемент. Модель
+    // точная для этого фильтра: число элементов в блоке из 512 бит —
+    // пуассоновское со средним 512 / bitsPerElement, и каждый из j элементов
+    // блока ставит по одному биту в каждое из 8 слов по 64 бита
+    static double falsePositiveRateFor(double bitsPerElement) {
+        const double load = 512.0 / bitsPerElement;
+        const double keep = 63.0 / 64.0;
+        double probability = std::exp(-load);  // P(j элементов в блоке), j = 0
+        double unset = 1.0;                    // (63/64)^j
+        double rate = 0.0;
+        const double last = load + 20.0 * std::sqrt(load) + 40.0;
+        for (double j = 0.0; j <= last; j += 1.0) {
+            rate += probability * std::pow(1.0 - unset, 8);
+            probability *= load / (j + 1.0);
+            unset *= keep;
+        }
+        return rate;
+    }
+
+    // Биты на элемент для желаемой доли ложных срабатываний сразу после
+    // перестройки: обращение falsePositiveRateFor делением отрезка пополам.
+    // Замер (./hw_prod7 --bench) совпадает с моделью в пределах долей процента
+    static double bitsFor(double falsePositiveRate) {
+        falsePositiveRate = std::min(0.5, std::max(1e-6, falsePositiveRate));
+        // Модель пересчитывается при каждом выборе реализации; доля почти всегда одна и та же
+        thread_local double cachedRate = -1.0;
+        thread_local double cachedBits = 0.0;
+        if (falsePositiveRate == cachedRate) return cachedBits;
+        double low = 1.0;
+        double high = 64.0;
+        for (int i = 0; i < 40; ++i) {
+            double middle = 0.5 * (low + high);
+            if (falsePositiveRateFor(middle) > falsePositiveRate) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        cachedRate = falsePositiveRate;
+        cachedBits = high;
+        return high;
+    }
+
+    // exact — точное множество, которым фильтр владеет
+    explicit FilteredSet(SetImpl* exact, double falsePositiveRate = 0.01)
+        : exact(exact), bitsPerElement(bitsFor(falsePositiveRate)) {
+        rebuild();
+    }
+
+    FilteredSet(const FilteredSet& other)
+        : exact(other.exact->clone()), blocks(other.blocks), bitsPerElement(other.bitsPerElement),
+          capacity(other.capacity), inserted(other.inserted), removed(other.removed) {}
+
+    FilteredSet& operator=(const FilteredSet&) = delete;
+
+    ~FilteredSet() override { delete exact; }
+
+    // false — элемента точно нет; true — может быть (или ложное срабатывание)
+    bool mayContain(int element) const {
+        uint64_t h = mix(element);
+        const Block& block = blocks[blockOf(h)];
+        for (int w = 0; w < 8; ++w) {
+            if ((block.words[w] & bitOf(h, w)) == 0) return false;
+        }
+        return true;
+    }
+
+    void add(int element) override {
+        size_t before = exact->size();
+        exact->add(element);
+        if (exact->size() == before) return;
+        if (inserted + 1 > capacity) {
+            rebuild();
+        } else {
+            insert(element);
+        }
+    }
+    void remove(int element) override {
+        size_t before = exact->size();
+        exact->remove(element);
+        afterRemove(before - exact->size());
+    }
+    bool contains(int element) const override {
+        return mayContain(element) && exact->contains(element);
+    }
+    std::vector<int> toVector() const override { return exact->toVector(); }
+    size_t size() const override { return exact->size(); }
+    SetImpl* clone() const override { return new FilteredSet(*this); }
+
+    Kind kind() const override { return FILTERED; }
+    bool canHold(int element) const override { return exact->canHold(element); }
+    bool isSorted() const override { return exact->isSorted(); }
+    const int* sortedElements() const override { return exact->sortedElements(); }
+    size_t memoryUsage() const override {
+        return sizeof(*this) + blocks.capacity() * sizeof(Block) + exact->memoryUsage();
+    }
+    void addAll(const std::vector<int>& elements) override {
+        exact->addAll(elements);
+        if (inserted + elements.size() > capacity) {
+            rebuild();
+        } else {
+            for (int element : elements) insert(element);
+        }
+    }
+
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = exact->drainInto(target, maxCount);
+        afterRemove(moved);
+        return moved;
+    }
+    bool bounds(int& low, int& high) const override { return exact->bounds(low, high); }
+
+    SetImpl::Kind exactKind() const { return exact->kind(); }
+    size_t filterBytes() const { return blocks.size() * sizeof(Block); }
+};
+
+// g. MappedSet: неизменяемый снимок множества в файле, отображённом в память
+//
+// Файл (порядок байт машины, проверяется при открытии):
+//
+//     [заголовок SetFileHeader | до 4096 байт]
+//     [count элементов int32 по возрастанию, с границы страницы]
+//     [ключи блоков: первый элемент каждого блока из blockSize элементов]
+//
+// Открытие — O(1) по объёму данных: проверяются заголовок и индекс блоков,
+// сами элементы не читаются, пока их не коснётся поиск. Страницы берутся из
+// кэша файлов ядра, поэтому процессы, открывшие один файл, делят одну копию.
+// Поиск: двоичный поиск по ключам блоков (небольшой массив, лежит в кэше),
+// затем внутри одного блока из 4 КБ — обычно одна страница данных.
+// Контрольная сумма элементов проверяется только по запросу (verify()),
+// так как требует прочитать весь файл.
+struct SetFileHeader {
+    char magic[8];            // "HWSET\0\0\0"
+    uint32_t byteOrder;       // 0x01020304 в порядке байт записавшей машины
+    uint32_t version;
+    uint64_t count;           // число элементов
+    uint64_t blockSize;       // элементов на один ключ индекса
+    uint64_t dataOffset;      // смещение элементов, кратно 4096
+    uint64_t indexOffset;     // смещение ключей блоков
+    uint64_t dataChecksum;
+    uint64_t indexChecksum;
+    uint64_t headerChecksum;  // по всем предыдущим полям
+};
+
+namespace SetFile {
+
+const char magic[8] = { 'H', 'W', 'S', 'E', 'T', 0, 0, 0 };
+const uint32_t byteOrder = 0x01020304u;
+const uint32_t version = 1;
+const uint64_t blockSize = 1024;
+const uint64_t dataOffset = 4096;
+
+inline uint64_t rotl(uint64_t x, int r) { return (x << r) | (x >> (64 - r)); }
+
+// Контрольная сумма в четыре независимые цепочки, чтобы не упираться
+// в задержку умножения; читает по 8 байт
+inline uint64_t checksum(const void* data, size_t bytes) {
+    const uint64_t p1 = 0x9E3779B185EBCA87ull;
+    const uint64_t p2 = 0xC2B2AE3D27D4EB4Full;
+    const unsigned char* pos = static_cast<const unsigned char*>(data);
+    uint64_t lanes[4] = { p1, p2, p1 ^ p2, ~p1 };
+    size_t i = 0;
+    for (; i + 32 <= bytes; i += 32) {
+        for (int k = 0; k < 4; ++k) {
+            uint64_t word;
+            std::memcpy(&word, pos + i + 8 * k, 8);
+            lanes[k] = rotl(lanes[k] + word * p2, 31) * p1;
+        }
+    }
+    uint64_t h = rotl(lanes[0], 1) + rotl(lanes[1], 7) + rotl(lanes[2], 12) + rotl(lanes[3], 18);
+    for (; i < bytes; i += 8) {
+        uint64_t word = 0;
+        std::memcpy(&word, pos + i, std::min<size_t>(8, bytes - i));
+        h = rotl(h ^ (word * p2), 27) * p1;
+    }
+    h ^= static_cast<uint64_t>(bytes);
+    h ^= h >> 33;
+    h *= p2;
+    return h ^ (h >> 29);
+}
+
+inline size_t indexSize(uint64_t count) {
+    return static_cast<size_t>((count + blockSize - 1) / blockSize);
+}
+
+// Открытый только для чтения файл снимка; отображение общее для всех копий MappedSet
+class Mapping {
+private:
+    void* address = nullptr;
+    size_t length = 0;
+    std::string path;
+
+public:
+    explicit Mapping(const std::string& path) : path(path) {
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("Cannot open set file '" + path + "': " + std::strerror(errno));
+        }
+        struct stat st;
+        if (::fstat(fd, &st) != 0) {
+            int error = errno;
+            ::close(fd);
+            throw std::runtime_error("Cannot stat set file '" + path + "': " + std::strerror(error));
+        }
+        length = static_cast<size_t>(st.st_size);
+        if (length < sizeof(SetFileHeader)) {
+            ::close(fd);
+            throw std::runtime_error("Set file '" + path + "' is too short");
+        }
+        // MAP_SHARED над файлом только для чтения: страницы — это кэш файлов
+        // ядра, общий для всех процессов, и при нехватке памяти они просто
+        // вытесняются, а не уходят в swap
+        address = ::mmap(nullptr, length, PROT_READ, MAP_SHARED, fd, 0);
+        int error = errno;
+        ::close(fd);
+        if (address == MAP_FAILED) {
+            address = nullptr;
+            throw std::runtime_error("Cannot map set file '" + path + "': " + std::strerror(error));
+        }
+        // Поиск обращается к случайным страницам — упреждающее чтение только мешает
+        ::madvise(address, length, MADV_RANDOM);
+    }
+
+    ~Mapping() {
+        if (address != nullptr) ::munmap(address, length);
+    }
+
+    Mapping(const Mapping&) = delete;
+    Mapping& operator=(const Mapping&) = delete;
+
+    const unsigned char* bytes() const { return static_cast<const unsigned char*>(address); }
+    size_t size() const { return length; }
+    const std::string& getPath() const { return path; }
+};
+
+// Запись снимка: во временный файл рядом и rename, чтобы открывающие файл
+// процессы никогда не видели его недописанным
+inline void write(const std::string& path, const int* sorted, size_t count) {
+    std::vector<int> index(indexSize(count));
+    for (size_t b = 0; b < index.size(); ++b) index[b] = sorted[b * blockSize];
+
+    SetFileHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, magic, sizeof(magic));
+    header.byteOrder = byteOrder;
+    header.version = version;
+    header.count = count;
+    header.blockSize = blockSize;
+    header.dataOffset = dataOffset;
+    header.indexOffset = (dataOffset + count * sizeof(int) + 63) / 64 * 64;
+    header.dataChecksum = checksum(sorted, count * sizeof(int));
+    header.indexChecksum = checksum(index.data(), index.size() * sizeof(int));
+    header.headerChecksum = checksum(&header, offsetof(SetFileHeader, headerChecksum));
+
+    const std::string temporary = path + ".tmp";
+    int fd = ::open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd < 0) {
+        throw std::runtime_error("Cannot create set file '" + temporary + "': " + std::strerror(errno));
+    }
+    auto writeAt = [&](const void* data, size_t bytes, uint64_t offset) {
+        const char* pos = static_cast<const char*>(data);
+        while (bytes > 0) {
+            ssize_t written = ::pwrite(fd, pos, bytes, static_cast<off_t>(offset));
+            if (written < 0) {
+                if (errno == EINTR) continue;
+                int error = errno;
+                ::close(fd);
+                ::unlink(temporary.c_str());
+                throw std::runtime_error("Cannot write set file '" + temporary + "': " + std::strerror(error));
+            }
+            pos += written;
+            bytes -= static_cast<size_t>(written);
+            offset += static_cast<uint64_t>(written);
+        }
+    };
+    writeAt(&header, sizeof(header), 0);
+    writeAt(sorted, count * sizeof(int), header.dataOffset);
+    writeAt(index.data(), index.size() * sizeof(int), header.indexOffset);
+    // Пустые промежутки между частями — дыры, их нужно довести до конца файла
+    if (::ftruncate(fd, static_cast<off_t>(header.indexOffset + index.size() * sizeof(int))) != 0 ||
+        ::fsync(fd) != 0) {
+        int error = errno;
+        ::close(fd);
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Cannot flush set file '" + temporary + "': " + std::strerror(error));
+    }
+    ::close(fd);
+    if (::rename(temporary.c_str(), path.c_str()) != 0) {
+        int error = errno;
+        ::unlink(temporary.c_str());
+        throw std::runtime_error("Cannot rename set file to '" + path + "': " + std::strerror(error));
+    }
+}
+
+}  // namespace SetFile
+
+class MappedSet : public SetImpl {
+private:
+    std::shared_ptr<const SetFile::Mapping> mapping;
+    const SetFileHeader* header;
+    const int* data;
+    const int* index;    // первый элемент каждого блока
+    size_t indexCount;
+    size_t total;        // элементов в файле
+    size_t first = 0;    // элементы до first уже перенесены drainInto
+
+    // Индекс первого элемента не меньше element по всему файлу
+    size_t lowerBound(int element) const {
+        // Блоки, начинающиеся не позже element; искомый элемент — в последнем из них
+        size_t block = lowerBoundBranchless(index, indexCount, element);
+        if (block < indexCount && index[block] == element) return block * SetFile::blockSize;
+        if (block == 0) return 0;
+        size_t begin = (block - 1) * SetFile::blockSize;
+        size_t end = std::min<size_t>(begin + SetFile::blockSize, total);
+        return begin + lowerBoundBranchless(data + begin, end - begin, element);
+    }
+
+    void readOnly() const {
+        throw std::logic_error("MappedSet '" + mapping->getPath() + "' is read-only");
+    }
+
+public:
+    // Проверка данных читает весь файл, поэтому по умолчанию выключена
+    explicit MappedSet(const std::string& path, bool verifyData = false)
+        : mapping(std::make_shared<const SetFile::Mapping>(path)) {
+        const unsigned char* bytes = mapping->bytes();
+        const size_t length = mapping->size();
+        header = reinterpret_cast<const SetFileHeader*>(bytes);
+        auto fail = [&](const char* what) {
+            throw std::runtime_error("Set file '" + path + "': " + what);
+        };
+        if (std::memcmp(header->magic, SetFile::magic, sizeof(SetFile::magic)) != 0) fail("not a set file");
+        if (header->byteOrder != SetFile::byteOrder) fail("written with a different byte order");
+        if (header->version != SetFile::version) fail("unsupported version");
+        if (header->headerChecksum != SetFile::checksum(header, offsetof(SetFileHeader, headerChecksum))) {
+            fail("header checksum mismatch");
+        }
+        total = static_cast<size_t>(header->count);
+        indexCount = SetFile::indexSize(header->count);
+        if (header->count > length / sizeof(int) || header->blockSize != SetFile::blockSize ||
+            header->dataOffset % 4096 != 0 || header->dataOffset > length ||
+            header->dataOffset < sizeof(SetFileHeader) ||
+            header->dataOffset + header->count * sizeof(int) > header->indexOffset ||
+            header->indexOffset % sizeof(int) != 0 || header->indexOffset > length ||
+            indexCount * sizeof(int) > length - header->indexOffset) {
+            fail("layout does not match file size");
+        }
+        data = reinterpret_cast<const int*>(bytes + header->dataOffset);
+        index = reinterpret_cast<const int*>(bytes + header->indexOffset);
+        if (header->indexChecksum != SetFile::checksum(index, indexCount * sizeof(int))) {
+            fail("index checksum mismatch");
+        }
+        if (verifyData && !verify()) fail("data checksum mismatch");
+    }
+
+    // Полная проверка контрольной суммы элементов
+    bool verify() const {
+        return header->dataChecksum == SetFile::checksum(data, total * sizeof(int));
+    }
+
+    // Запись снимка из произвольных элементов (повторы убираются)
+    static void save(const std::string& path, std::vector<int> elements) {
+        std::sort(elements.begin(), elements.end());
+        elements.erase(std::unique(elements.begin(), elements.end()), elements.end());
+        SetFile::write(path, elements.data(), elements.size());
+    }
+
+    static void save(const std::string& path, const SetImpl& set) {
+        if (set.sortedElements() != nullptr) {
+            SetFile::write(path, set.sortedElements(), set.size());
+        } else {
+            save(path, set.toVector());
+        }
+    }
+
+    void add(int) override { readOnly(); }
+    void remove(int) override { readOnly(); }
+    bool contains(int element) const override {
+        size_t i = lowerBound(element);
+        return i >= first && i < total && data[i] == element;
+    }
+    std::vector<int> toVector() const override { return std::vector<int>(data + first, data + total); }
+    size_t size() const override { return total - first; }
+    // Копия делит с оригиналом одно отображение
+    SetImpl* clone() const override { return new MappedSet(*this); }
+
+    Kind kind() const override { return MAPPED; }
+    bool canHold(int) const override { return false; }
+    bool isSorted() const override { return true; }
+    const int* sortedElements() const override { return data + first; }
+    bool isReadOnly() const override { return true; }
+    // Только собственная память: страницы файла общие и вытесняемые (см. fileBytes())
+    size_t memoryUsage() const override { return sizeof(*this); }
+
+    // Файл не меняется: перенесённые элементы просто отрезаются от начала.
+    // По возрастанию, поэтому FlatSet и RoaringSet добавляют их в конец
+    size_t drainInto(SetImpl& target, size_t maxCount) override {
+        size_t moved = std::min(maxCount, size());
+        if (moved == size()) {
+            target.addAll(toVector());
+        } else {
+            for (size_t i = first; i < first + moved; ++i) target.add(data[i]);
+        }
+        first += moved;
+        return moved;
+    }
+    bool bounds(int& low, int& high) const override {
+        if (size() == 0) return false;
+        low = data[first];
+        high = data[total - 1];
+        return true;
     }
+
+    size_t fileBytes() const { return mapping->size(); }
+    const std::string& path() const { return mapping->getPath(); }
+};
+
+// Политика смены реализации
+//
+// Для каждой реализации оценивается цена операции (условные наносекунды) с
+// учётом размера, диапазона значений, доли изменяющих операций и памяти.
+// Разница с лучшей реализацией копится как «упущенная выгода»; переход
+// происходит, когда она превысит стоимость переноса элементов, умноженную на
+// hysteresis. Поэтому колебания размера около границы не вызывают
+// переключений на каждой операции.
+struct SwitchPolicy {
+    double hysteresis = 2.0;
+    double memoryWeight = 1.0;    // цена байта памяти на элемент
+    size_t migrationStep = 64;    // элементов переносится за одну операцию; 0 — сразу все
+    double filterFalsePositiveRate = 0.01;  // для FilteredSet, который выбирается при частых промахах поиска
+};
+
+// Счётчики переходов вместо вывода в консоль
+struct SwitchStats {
+    size_t switches = 0;
+    size_t forcedSwitches = 0;   // текущая реализация не могла принять элемент
+    size_t elementsMoved = 0;
 };
 
+// 3. Абстракция (Bridge Abstraction)
+//
+// Во время перехода элементы постепенно переносятся из previous в impl:
+// каждая изменяющая операция переносит migrationStep элементов, поиск
+// смотрит в обе реализации.
+class Set {
+protected:
+    SetImpl* impl;
+    size_t threshold; // Threshold for switching implementations
+
+    SetImpl* previous = nullptr;
+    SwitchPolicy policy;
+    SwitchStats stats;
+
+    // Границы значений; после удалений могут быть шире фактических
+    int minValue = 0;
+    int maxValue = 0;
+    bool hasBounds = false;
+
+    // Статистика операций для модели стоимости (затухает со временем)
+    mutable size_t lookupsSinceCheck = 0;
+    mutable size_t missesSinceCheck = 0;
+    size_t updatesSinceCheck = 0;
+    double lookupWeight = 0.0;
+    double missWeight = 0.0;
+    double updateWeight = 0.0;
+    double regret = 0.0;
+
+    static const uint64_t bitmapMaxRange = uint64_t(1) << 28;
+    static constexpr double moveCost = 20.0;  // перенос одного элемента
+    static const size_t checkInterval = 16;   // модель пересчитывается раз в checkInterval изменений
+
+public:
+    Set(SetImpl* impl, size_t threshold) : impl(impl), threshold(threshold) {
+        recomputeBounds();
+    }
+    virtual ~Set() {
+        delete previous;
+        delete impl;
+    }
+
+    Set(const Set&) = delete;
+    Set& operator=(const Set&) = delete;
+
+    void add(int element) {
+        if (containsImpl(element)) {
+            afterUpdate();
+            return;
+        }
+        extendBounds(element);
+        if (!impl->canHold(element) || !feasible(impl->kind(), size() + 1)) {
+            forceSwitch(size() + 1);
+        }
+        impl->add(element);
+        afterUpdate();
+    }
+
+    void remove(int element) {
+        // Снимок из файла не меняется: сначала копия в обычную реализацию
+        if (impl->isReadOnly() || (previous != nullptr && previous->isReadOnly())) {
+            if (!containsImpl(element)) {
+                afterUpdate();
+                return;
+            }
+            forceSwitch(size());
+        }
+        impl->remove(element);
+        if (previous != nullptr) {
+            previous->remove(element);
+        }
+        afterUpdate();
+    }
+
+    bool contains(int element) const {
+        ++lookupsSinceCheck;
+        bool found = containsImpl(element);
+        missesSinceCheck += !found;
+        return found;
+    }
+
+    size_t size() const { return impl->size() + (previous != nullptr ? previous->size() : 0); }
+
+    std::vector<int> toVector() const {
+        std::vector<int> result = impl->toVector();
+        if (previous != nullptr) {
+            std::vector<int> rest = previous->toVector();
+            result.insert(result.end(), rest.begin(), rest.end());
+        }
+        return result;
+    }
+
+    SetImpl::Kind implementationKind() const { return impl->kind(); }
+
+    // Неизменяемый снимок для MappedSet
+    void saveSnapshot(const std::string& path) const {
+        if (previous == nullptr) {
+            MappedSet::save(path, *impl);
+        } else {
+            MappedSet::save(path, toVector());
+        }
+    }
+
+    size_t memoryUsage() const { return impl->memoryUsage() + (previous != nullptr ? previous->memoryUsage() : 0); }
+    bool isMigrating() const { return previous != nullptr; }
+
+    void setPolicy(const SwitchPolicy& newPolicy) { policy = newPolicy; }
+    const SwitchPolicy& getPolicy() const { return policy; }
+    const SwitchStats& getSwitchStats() const { return stats; }
+
+    // Завершить начатый перенос элементов
+    void finishMigration() {
+        if (previous != nullptr) {
+            stats.elementsMoved += previous->drainInto(*impl, previous->size());
+            delete previous;
+            previous = nullptr;
+        }
+    }
+
+    enum Operation {
+        UNION,
+        INTERSECTION,
+        DIFFERENCE,
+        SYMMETRIC_DIFFERENCE
+    };
+
+    Set* unite(const Set& other) const { return combine(other, UNION); }
+    Set* intersect(const Set& other) const { return combine(other, INTERSECTION); }
+    Set* difference(const Set& other) const { return combine(other, DIFFERENCE); }
+    Set* symmetricDifference(const Set& other) const { return combine(other, SYMMETRIC_DIFFERENCE); }
+
+    // Варианты без создания нового Set
+    void uniteInPlace(const Set& other) { combineInPlace(other, UNION); }
+    void intersectInPlace(const Set& other) { combineInPlace(other, INTERSECTION); }
+    void differenceInPlace(const Set& other) { combineInPlace(other, DIFFERENCE); }
+    void symmetricDifferenceInPlace(const Set& other) { combineInPlace(other, SYMMETRIC_DIFFERENCE); }
+
+    Set* combine(const Set& other, Operation op) const {
+        Set* newSet = new Set(new ArraySet(threshold), threshold);
+        newSet->setPolicy(policy);
+        newSet->replaceImpl(combineImpl(other, op));
+        return newSet;
+    }
+
+    void combineInPlace(const Set& other, Operation op) {
+        finishMigration();
+
+        // Мало элементов справа и дешёвые add/remove: меняем текущую реализацию напрямую
+        bool cheapUpdates = impl->kind() == SetImpl::HASH || impl->kind() == SetImpl::BITMAP ||
+                            impl->kind() == SetImpl::ROARING || impl->kind() == SetImpl::FILTERED;
+        if (&other != this && cheapUpdates && other.size() * 8 < impl->size()) {
+            if (op == DIFFERENCE) {
+                for (int element : other.toVector()) impl->remove(element);
+                recomputeBounds();
+                return;
+            }
+            if (op == UNION) {
+                for (int element : other.toVector()) {
+                    if (!impl->contains(element)) add(element);
+                }
+                return;
+            }
+        }
+        replaceImpl(combineImpl(other, op));
+    }
+
+protected:
+    // Пересечение отсортированных массивов при сильном перекосе размеров:
+    // для каждого элемента меньшего массива — экспоненциальный поиск в большем
+    static void gallopingIntersect(const int* small, size_t smallSize, const int* large, size_t n, std::vector<int>& out) {
+        size_t pos = 0;
+        for (const int* it = small; it != small + smallSize; ++it) {
+            int x = *it;
+            size_t bound = 1;
+            while (pos + bound < n && large[pos + bound] < x) bound *= 2;
+            size_t hi = std::min(pos + bound + 1, n);
+            pos += lowerBoundBranchless(large + pos, hi - pos, x);
+            if (pos == n) break;
+            if (large[pos] == x) {
+                out.push_back(x);
+                ++pos;
+            }
+        }
+    }
+
+    static std::vector<int> combineSorted(const int* a, size_t aSize, const int* b, size_t bSize, Operation op) {
+        std::vector<int> result;
+        switch (op) {
+            case UNION:
+                result.reserve(aSize + bSize);
+                std::set_union(a, a + aSize, b, b + bSize, std::back_inserter(result));
+                break;
+            case INTERSECTION: {
+                bool leftSmaller = aSize <= bSize;
+                size_t smallSize = leftSmaller ? aSize : bSize;
+                size_t largeSize = leftSmaller ? bSize : aSize;
+                result.reserve(smallSize);
+                if (smallSize * 32 < largeSize) {
+                    gallopingIntersect(leftSmaller ? a : b, smallSize, leftSmaller ? b : a, largeSize, result);
+                } else {
+                    std::set_intersection(a, a + aSize, b, b + bSize, std::back_inserter(result));
+                }
+                break;
+            }
+            case DIFFERENCE:
+                result.reserve(aSize);
+                std::set_difference(a, a + aSize, b, b + bSize, std::back_inserter(result));
+                break;
+            case SYMMETRIC_DIFFERENCE:
+                result.reserve(aSize + bSize);
+                std::set_symmetric_difference(a, a + aSize, b, b + bSize, std::back_inserter(result));
+                break;
+        }
+        return result;
+    }
+
+    // Новая реализация с результатом операции; *this и other не меняются
+    SetImpl* combineImpl(const Set& other, Operation op) const {
+        // Во время переноса элементы лежат в двух реализациях, поэтому быстрые
+        // пути по представлению доступны только для завершённых переходов
+        bool settled = previous == nullptr && other.previous == nullptr;
+
+        // Две битовые карты — пословно
+        const BitmapSet* leftBitmap = dynamic_cast<const BitmapSet*>(impl);
+        const BitmapSet* rightBitmap = dynamic_cast<const BitmapSet*>(other.impl);
+        if (settled && leftBitmap != nullptr && rightBitmap != nullptr) {
+            static const BitmapSet::Operation bitmapOps[] = { BitmapSet::OR, BitmapSet::AND, BitmapSet::AND_NOT, BitmapSet::XOR };
+            return BitmapSet::combine(*leftBitmap, *rightBitmap, bitmapOps[op]);
+        }
+
+        std::vector<int> result;
+        bool sorted = true;
+        if (settled && impl->isSorted() && other.impl->isSorted()) {
+            // FlatSet и MappedSet читаются на месте, остальные — через копию
+            std::vector<int> leftCopy;
+            std::vector<int> rightCopy;
+            const int* left = impl->sortedElements();
+            const int* right = other.impl->sortedElements();
+            if (left == nullptr) {
+                leftCopy = impl->toVector();
+                left = leftCopy.data();
+            }
+            if (right == nullptr) {
+                rightCopy = other.impl->toVector();
+                right = rightCopy.data();
+            }
+            result = combineSorted(left, impl->size(), right, other.impl->size(), op);
+        } else if (op == INTERSECTION) {
+            // Обходим меньшее множество и ищем его элементы в большем
+            const Set& small = size() <= other.size() ? *this : other;
+            const Set& large = size() <= other.size() ? other : *this;
+            sorted = small.previous == nullptr && small.impl->isSorted();
+            for (int element : small.toVector()) {
+                if (large.contains(element)) result.push_back(element);
+            }
+        } else if (op == DIFFERENCE) {
+            sorted = previous == nullptr && impl->isSorted();
+            for (int element : toVector()) {
+                if (!other.contains(element)) result.push_back(element);
+            }
+        } else if (op == SYMMETRIC_DIFFERENCE) {
+            sorted = false;
+            for (int element : toVector()) {
+                if (!other.contains(element)) result.push_back(element);
+            }
+            for (int element : other.toVector()) {
+                if (!contains(element)) result.push_back(element);
+            }
+        } else {
+            result = toVector();
+            std::vector<int> rest = other.toVector();
+            result.insert(result.end(), rest.begin(), rest.end());
+            std::sort(result.begin(), result.end());
+            result.erase(std::unique(result.begin(), result.end()), result.end());
+        }
+        return buildImpl(std::move(result), sorted);
+    }
+
+    // Реализация, выбранная политикой под готовый набор различных элементов
+    SetImpl* buildImpl(std::vector<int>&& elements, bool sorted) const {
+        if (!sorted) {
+            std::sort(elements.begin(), elements.end());
+        }
+
+        int low = elements.empty() ? 0 : elements.front();
+        int high = elements.empty() ? 0 : elements.back();
+        SetImpl::Kind kind = chooseKind(elements.size(), low, high, !elements.empty());
+        if (kind == SetImpl::FLAT) {
+            return new FlatSet(std::move(elements));
+        }
+        SetImpl* result = createImpl(kind, low, high);
+        result->addAll(elements);
+        return result;
+    }
+
+    void replaceImpl(SetImpl* newImpl) {
+        delete previous;
+        previous = nullptr;
+        delete impl;
+        impl = newImpl;
+        regret = 0.0;
+        recomputeBounds();
+    }
+
+    bool containsImpl(int element) const {
+        return impl->contains(element) || (previous != nullptr && previous->contains(element));
+    }
+
+    void extendBounds(int element) {
+        if (!hasBounds) {
+            minValue = maxValue = element;
+            hasBounds = true;
+        } else {
+            minValue = std::min(minValue, element);
+            maxValue = std::max(maxValue, element);
+        }
+    }
+
+    void recomputeBounds() {
+        hasBounds = false;
+        int low;
+        int high;
+        if (impl->bounds(low, high)) {
+            extendBounds(low);
+            extendBounds(high);
+        }
+        if (previous != nullptr && previous->bounds(low, high)) {
+            extendBounds(low);
+            extendBounds(high);
+        }
+    }
+
+    bool feasible(SetImpl::Kind kind, size_t expectedSize) const {
+        if (kind == SetImpl::ARRAY) return expectedSize <= threshold;
+        return true;
+    }
+
+    // Оценка цены одной операции для реализации kind, условные наносекунды
+    double estimateCost(SetImpl::Kind kind, size_t n, uint64_t range, double updateShare) const {
+        const double inf = std::numeric_limits<double>::infinity();
+        double size = static_cast<double>(std::max<size_t>(n, 1));
+        double lookup;
+        double update;
+        double bytes;
+        switch (kind) {
+            case SetImpl::ARRAY:
+                if (n > threshold) return inf;
+                lookup = 1.0 + 0.25 * size;
+                update = lookup + 1.0;
+                bytes = 4.0;
+                break;
+            case SetImpl::FLAT:
+                lookup = 2.0 + 1.5 * std::log2(size + 1.0);
+                update = lookup + 0.05 * size;
+                bytes = 4.0;
+                break;
+            case SetImpl::HASH:
+                lookup = size > (1 << 20) ? 55.0 : 25.0;
+                update = 2.0 * lookup + 10.0;
+                bytes = 40.0;
+                break;
+            case SetImpl::FILTERED: {
+                // Фильтр перед HashSet: в хэш-таблицу идут попадания и ложные срабатывания
+                double probe = size > (1 << 20) ? 55.0 : 25.0;
+                double filter = size > (1 << 20) ? 15.0 : 4.0;
+                double misses = missShare();
+                double rate = policy.filterFalsePositiveRate;
+                lookup = filter + (1.0 - misses + misses * rate) * probe;
+                update = 2.0 * probe + 10.0 + filter;
+                bytes = 40.0 + FilteredSet::bitsFor(rate) / 8.0;
+                break;
+            }
+            case SetImpl::MAPPED:
+                // Поиск как у FlatSet, но любое изменение копирует весь снимок;
+                // память процесса не расходуется — страницы общие
+                lookup = 4.0 + 1.5 * std::log2(size + 1.0);
+                update = lookup + moveCost * size;
+                bytes = 0.0;
+                break;
+            case SetImpl::BITMAP:
+                if (range > bitmapMaxRange) return inf;
+                lookup = 3.0;
+                update = 4.0;
+                // С учётом запаса по краям, который добавляет createImpl
+                bytes = (static_cast<double>(range) * 1.25 + 128.0) / 8.0 / size;
+                break;
+            case SetImpl::ROARING: {
+                // Случайные значения из range занимают blocks·(1 − e^(−n/blocks)) блоков
+                double blocks = static_cast<double>(range / 65536 + 1);
+                double empty = std::exp(-size / blocks);
+                double containers = std::max(1.0, blocks * (1.0 - empty));
+                double perContainer = size / containers;
+                lookup = 10.0 + 5.0 * std::log2(containers + 1.0) +
+                         (perContainer <= 4096 ? 2.0 * std::log2(perContainer + 1.0) : 1.0);
+                // Новый блок (вероятность empty) сдвигает в среднем половину блоков
+                update = lookup + (perContainer <= 4096 ? 0.02 * perContainer : 1.0) + 5.0 +
+                         0.5 * containers * empty;
+                bytes = (64.0 * containers + std::min(2.0 * size, 8192.0 * containers)) / size;
+                break;
+            }
+            default:
+                return inf;
+        }
+        return lookup * (1.0 - updateShare) + update * updateShare + policy.memoryWeight * bytes;
+    }
+
+    uint64_t currentRange() const {
+        return hasBounds ? static_cast<uint64_t>(int64_t(maxValue) - int64_t(minValue)) + 1 : 0;
+    }
+
+    SetImpl::Kind chooseKind(size_t expectedSize, int low, int high, bool bounded, double updateShare = 0.5) const {
+        static const SetImpl::Kind kinds[] = { SetImpl::ARRAY, SetImpl::FLAT, SetImpl::HASH, SetImpl::BITMAP, SetImpl::ROARING,
+                                               SetImpl::FILTERED };
+        uint64_t range = bounded ? static_cast<uint64_t>(int64_t(high) - int64_t(low)) + 1 : 0;
+        SetImpl::Kind best = SetImpl::HASH;
+        double bestCost = std::numeric_limits<double>::infinity();
+        for (SetImpl::Kind kind : kinds) {
+            double cost = estimateCost(kind, expectedSize, range, updateShare);
+            if (cost < bestCost) {
+                bestCost = cost;
+                best = kind;
+            }
+        }
+        return best;
+    }
+
+    SetImpl* createImpl(SetImpl::Kind kind, int low, int high) const {
+        switch (kind) {
+            case SetImpl::ARRAY: return new ArraySet(threshold);
+            case SetImpl::FLAT: return new FlatSet();
+            case SetImpl::HASH: return new HashSet();
+            case SetImpl::ROARING: return new RoaringSet();
+            case SetImpl::FILTERED: return new FilteredSet(new HashSet(), policy.filterFalsePositiveRate);
+            // Снимок открывается только из файла; ближайшая изменяемая реализация — FlatSet
+            case SetImpl::MAPPED: return new FlatSet();
+            case SetImpl::BITMAP: {
+                // Запас по краям, чтобы соседние значения не вызывали новый переход
+                int64_t slack = (int64_t(high) - int64_t(low)) / 8 + 64;
+                int64_t first = std::max<int64_t>(int64_t(low) - slack, INT32_MIN);
+                int64_t last = std::min<int64_t>(int64_t(high) + slack, INT32_MAX);
+                return new BitmapSet(static_cast<int>(first), static_cast<int>(last));
+            }
+        }
+        return new HashSet();
+    }
+
+    // Текущая реализация не может принять элемент: переносим всё сразу
+    void forceSwitch(size_t expectedSize) {
+        int low = minValue;
+        int high = maxValue;
+        recomputeBounds();
+        extendBounds(low);
+        extendBounds(high);
+
+        SetImpl::Kind kind = chooseKind(expectedSize, minValue, maxValue, hasBounds, updateShare());
+        if (kind == SetImpl::ARRAY && !feasible(kind, expectedSize)) kind = SetImpl::FLAT;
+        SetImpl* newImpl = createImpl(kind, minValue, maxValue);
+        stats.elementsMoved += impl->drainInto(*newImpl, impl->size());
+        if (previous != nullptr) {
+            stats.elementsMoved += previous->drainInto(*newImpl, previous->size());
+            delete previous;
+            previous = nullptr;
+        }
+        delete impl;
+        impl = newImpl;
+        regret = 0.0;
+        ++stats.switches;
+        ++stats.forcedSwitches;
+    }
+
+    double updateShare() const {
+        double total = lookupWeight + updateWeight;
+        return total > 0.0 ? updateWeight / total : 0.5;
+    }
+
+    // Доля промахов среди поисков; пока поисков не было — 0
+    double missShare() const {
+        return lookupWeight > 0.0 ? missWeight / lookupWeight : 0.0;
+    }
+
+    void afterUpdate() {
+        if (previous != nullptr) {
+            stats.elementsMoved += previous->drainInto(*impl, policy.migrationStep);
+            if (previous->size() == 0) {
+                delete previous;
+                previous = nullptr;
+            }
+        }
+        switchImplementationIfNeeded();
+    }
+
+    virtual void switchImplementationIfNeeded() {
+        if (++updatesSinceCheck < checkInterval) return;
+        size_t lookups = lookupsSinceCheck;
+        size_t misses = missesSinceCheck;
+        size_t updates = updatesSinceCheck;
+        lookupsSinceCheck = 0;
+        missesSinceCheck = 0;
+        updatesSinceCheck = 0;
+        // Окно примерно в 4096 последних изменений
+        const double decay = std::pow(1.0 - 1.0 / 4096.0, static_cast<double>(updates));
+        lookupWeight = lookupWeight * decay + static_cast<double>(lookups);
+        missWeight = missWeight * decay + static_cast<double>(misses);
+        updateWeight = updateWeight * decay + static_cast<double>(updates);
+
+        if (previous != nullptr) return;
+
+        size_t n = impl->size();
+        double share = updateShare();
+        uint64_t range = currentRange();
+        SetImpl::Kind current = impl->kind();
+        SetImpl::Kind best = chooseKind(n, minValue, maxValue, hasBounds, share);
+        if (best == current) {
+            regret = 0.0;
+            return;
+        }
+
+        double currentCost = estimateCost(current, n, range, share);
+        double bestCost = estimateCost(best, n, range, share);
+        regret += (currentCost - bestCost) * static_cast<double>(lookups + updates);
+        double migrationCost = moveCost * static_cast<double>(n) + 1000.0;
+        if (regret < policy.hysteresis * migrationCost) return;
+
+        // Границы сужаются только при переходе, чтобы не пересчитывать их на каждом удалении
+        recomputeBounds();
+        best = chooseKind(n, minValue, maxValue, hasBounds, share);
+        regret = 0.0;
+        if (best == current) return;
+
+        ++stats.switches;
+        previous = impl;
+        impl = createImpl(best, minValue, maxValue);
+        // Снимок из файла переносится сразу: по частям он копировался бы поэлементно
+        if (policy.migrationStep == 0 || previous->size() <= policy.migrationStep || previous->isReadOnly()) {
+            finishMigration();
+        }
+    }
+};
+
+
+// 4. Обобщённое множество для произвольных ключей
+//
+// Та же идея «маленькое/большое множество», но без виртуальных вызовов:
+// реализация хранится в std::variant, а пороги задаются политикой на этапе
+// компиляции. Маленькие множества лежат прямо в объекте, большие — в
+// открытой адресации по группам из 16 управляющих байт (как в Swiss table).
+namespace GenericSetDetails {
+
+// Управляющий байт: 0..127 — занято (7 младших бит хэша), иначе пусто или удалено
+const int8_t emptyControl = -128;
+const int8_t deletedControl = -2;
+const size_t groupWidth = 16;
+
+// Стандартный std::hash для целых — тождественная функция, поэтому биты перемешиваются
+inline uint64_t mixHash(size_t hash) {
+    uint64_t h = static_cast<uint64_t>(hash) * 0x9E3779B97F4A7C15ull;
+    return h ^ (h >> 32);
+}
+
+// Группа из 16 управляющих байт; маски — по биту на позицию
+class Group {
+private:
+#ifdef __SSE2__
+    __m128i bytes;
+#else
+    int8_t bytes[groupWidth];
+#endif
+
+public:
+    explicit Group(const int8_t* control) {
+#ifdef __SSE2__
+        bytes = _mm_loadu_si128(reinterpret_cast<const __m128i*>(control));
+#else
+        std::memcpy(bytes, control, groupWidth);
+#endif
+    }
+
+    uint32_t match(int8_t value) const {
+#ifdef __SSE2__
+        return static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(value), bytes)));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < groupWidth; ++i) mask |= uint32_t(bytes[i] == value) << i;
+        return mask;
+#endif
+    }
+
+    uint32_t matchEmpty() const { return match(emptyControl); }
+
+    // Пустые и удалённые байты отрицательны — достаточно знаковых битов
+    uint32_t matchFree() const {
+#ifdef __SSE2__
+        return static_cast<uint32_t>(_mm_movemask_epi8(bytes));
+#else
+        uint32_t mask = 0;
+        for (size_t i = 0; i < groupWidth; ++i) mask |= uint32_t(bytes[i] < 0) << i;
+        return mask;
+#endif
+    }
+};
+
+} // namespace GenericSetDetails
+
+namespace Generic {
+
+// Пороги переключения: больше inlineCapacity элементов — таблица,
+// не больше shrinkSize — обратно во встроенный буфер
+struct DefaultSetPolicy {
+    static const size_t inlineCapacity = 8;
+    static const size_t shrinkSize = 4;
+};
+
+// Маленькое множество во встроенном буфере, линейный поиск
+template <typename T, size_t N>
+class InlineSet {
+private:
+    T items[N];
+    size_t count = 0;
+
+public:
+    bool contains(const T& element) const {
+        for (size_t i = 0; i < count; ++i) {
+            if (items[i] == element) return true;
+        }
+        return false;
+    }
+
+    bool full() const { return count == N; }
+
+    // Вызывающий проверяет, что элемента нет и место есть
+    void append(const T& element) { items[count++] = element; }
+
+    bool remove(const T& element) {
+        for (size_t i = 0; i < count; ++i) {
+            if (items[i] == element) {
+                items[i] = std::move(items[count - 1]);
+                --count;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    size_t size() const { return count; }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < count; ++i) f(items[i]);
+    }
+
+    // Перенос элементов в другой контейнер; буфер остаётся пустым
+    template <typename F>
+    void drain(F&& f) {
+        for (size_t i = 0; i < count; ++i) f(std::move(items[i]));
+        count = 0;
+    }
+
+    size_t memoryUsage() const { return sizeof(*this); }
+};
+
+// Открытая адресация с группами по 16 слотов
+//
+// Поиск сравнивает 7 бит хэша сразу с 16 управляющими байтами группы и
+// проверяет ключи только у совпавших позиций. Группы перебираются с
+// треугольным шагом; поиск останавливается на группе с пустым слотом.
+template <typename T, typename Hash>
+class SwissSet {
+private:
+    int8_t* control = nullptr;
+    T* slots = nullptr;
+    size_t capacity = 0;    // кратна groupWidth, число групп — степень двойки
+    size_t count = 0;
+    size_t growthLeft = 0;  // сколько ещё пустых слотов можно занять до перестройки
+    Hash hasher;
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+    size_t groupMask() const { return capacity / GenericSetDetails::groupWidth - 1; }
+
+    // Заполнение не выше 7/8
+    static size_t maxLoad(size_t slotCount) { return slotCount - slotCount / 8; }
+
+    void allocate(size_t slotCount) {
+        capacity = slotCount;
+        control = new int8_t[capacity];
+        std::memset(control, GenericSetDetails::emptyControl, capacity);
+        slots = static_cast<T*>(::operator new(capacity * sizeof(T)));
+        count = 0;
+        growthLeft = maxLoad(capacity);
+    }
+
+    void release() {
+        if (control == nullptr) return;
+        for (size_t i = 0; i < capacity; ++i) {
+            if (control[i] >= 0) slots[i].~T();
+        }
+        ::operator delete(slots);
+        delete[] control;
+        control = nullptr;
+        slots = nullptr;
+        capacity = count = growthLeft = 0;
+    }
+
+    size_t find(const T& element, uint64_t hash) const {
+        if (capacity == 0) return npos;
+        const int8_t tag = static_cast<int8_t>(hash & 0x7F);
+        size_t mask = groupMask();
+        size_t group = (hash >> 7) & mask;
+        for (size_t step = 1;; ++step) {
+            size_t base = group * GenericSetDetails::groupWidth;
+            GenericSetDetails::Group g(control + base);
+            for (uint32_t m = g.match(tag); m != 0; m &= m - 1) {
+                size_t i = base + static_cast<size_t>(__builtin_ctz(m));
+                if (slots[i] == element) return i;
+            }
+            if (g.matchEmpty() != 0) return npos;
+            group = (group + step) & mask;
+        }
+    }
+
+    // Первый свободный слот на пути поиска
+    size_t findFree(uint64_t hash) const {
+        size_t mask = groupMask();
+        size_t group = (hash >> 7) & mask;
+        for (size_t step = 1;; ++step) {
+            size_t base = group * GenericSetDetails::groupWidth;
+            uint32_t m = GenericSetDetails::Group(control + base).matchFree();
+            if (m != 0) return base + static_cast<size_t>(__builtin_ctz(m));
+            group = (group + step) & mask;
+        }
+    }
+
+    template <typename U>
+    void insertNew(U&& element, uint64_t hash) {
+        size_t i = findFree(hash);
+        growthLeft -= control[i] == GenericSetDetails::emptyControl;
+        control[i] = static_cast<int8_t>(hash & 0x7F);
+        new (slots + i) T(std::forward<U>(element));
+        ++count;
+    }
+
+    void rehash(size_t slotCount) {
+        int8_t* oldControl = control;
+        T* oldSlots = slots;
+        size_t oldCapacity = capacity;
+        allocate(slotCount);
+        for (size_t i = 0; i < oldCapacity; ++i) {
+            if (oldControl[i] >= 0) {
+                insertNew(std::move(oldSlots[i]), GenericSetDetails::mixHash(hasher(oldSlots[i])));
+                oldSlots[i].~T();
+            }
+        }
+        ::operator delete(oldSlots);
+        delete[] oldControl;
+    }
+
+    static size_t slotsFor(size_t elements) {
+        size_t slotCount = GenericSetDetails::groupWidth;
+        while (maxLoad(slotCount) < elements) slotCount *= 2;
+        return slotCount;
+    }
+
+public:
+    SwissSet() {}
+
+    SwissSet(const SwissSet& other) : hasher(other.hasher) {
+        if (other.count > 0) {
+            allocate(slotsFor(other.count));
+            other.forEach([this](const T& element) { insertNew(element, GenericSetDetails::mixHash(hasher(element))); });
+        }
+    }
+
+    SwissSet(SwissSet&& other) noexcept
+        : control(other.control), slots(other.slots), capacity(other.capacity), count(other.count),
+          growthLeft(other.growthLeft), hasher(std::move(other.hasher)) {
+        other.control = nullptr;
+        other.slots = nullptr;
+        other.capacity = other.count = other.growthLeft = 0;
+    }
+
+    SwissSet& operator=(SwissSet other) noexcept {
+        std::swap(control, other.control);
+        std::swap(slots, other.slots);
+        std::swap(capacity, other.capacity);
+        std::swap(count, other.count);
+        std::swap(growthLeft, other.growthLeft);
+        std::swap(hasher, other.hasher);
+        return *this;
+    }
+
+    ~SwissSet() { release(); }
+
+    void reserve(size_t elements) {
+        if (maxLoad(capacity) < elements) rehash(slotsFor(elements));
+    }
+
+    bool contains(const T& element) const {
+        return find(element, GenericSetDetails::mixHash(hasher(element))) != npos;
+    }
+
+    template <typename U>
+    bool add(U&& element) {
+        uint64_t hash = GenericSetDetails::mixHash(hasher(element));
+        if (find(element, hash) != npos) return false;
+        if (growthLeft == 0) {
+            // Много удалённых слотов — перестраиваем на месте, иначе растём
+            rehash(capacity == 0 ? GenericSetDetails::groupWidth
+                   : count * 2 < maxLoad(capacity) ? capacity : capacity * 2);
+        }
+        insertNew(std::forward<U>(element), hash);
+        return true;
+    }
+
+    bool remove(const T& element) {
+        size_t i = find(element, GenericSetDetails::mixHash(hasher(element)));
+        if (i == npos) return false;
+        slots[i].~T();
+        --count;
+        // Если в группе есть пустой слот, поиск на ней и так останавливается
+        size_t base = i - i % GenericSetDetails::groupWidth;
+        if (GenericSetDetails::Group(control + base).matchEmpty() != 0) {
+            control[i] = GenericSetDetails::emptyControl;
+            ++growthLeft;
+        } else {
+            control[i] = GenericSetDetails::deletedControl;
+        }
+        return true;
+    }
+
+    size_t size() const { return count; }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (control[i] >= 0) f(slots[i]);
+        }
+    }
+
+    template <typename F>
+    void drain(F&& f) {
+        for (size_t i = 0; i < capacity; ++i) {
+            if (control[i] >= 0) f(std::move(slots[i]));
+        }
+        release();
+    }
+
+    size_t memoryUsage() const { return sizeof(*this) + capacity * (1 + sizeof(T)); }
+};
+
+// Адаптивное множество: InlineSet, пока элементов мало, затем SwissSet
+template <typename T, typename Hash = std::hash<T>, typename Policy = DefaultSetPolicy>
+class Set {
+private:
+    static_assert(Policy::shrinkSize < Policy::inlineCapacity, "shrinkSize must be below inlineCapacity");
+
+    using Small = InlineSet<T, Policy::inlineCapacity>;
+    using Large = SwissSet<T, Hash>;
+
+    std::variant<Small, Large> impl;
+
+    void growAndAdd(const T& element) {
+        Small& small = std::get<Small>(impl);
+        Large large;
+        large.reserve(2 * Policy::inlineCapacity);
+        small.drain([&large](T&& item) { large.add(std::move(item)); });
+        large.add(element);
+        impl = std::move(large);
+    }
+
+    void shrink() {
+        Large& large = std::get<Large>(impl);
+        Small small;
+        large.drain([&small](T&& item) { small.append(std::move(item)); });
+        impl = std::move(small);
+    }
+
+public:
+    void add(const T& element) {
+        if (Small* small = std::get_if<Small>(&impl)) {
+            if (small->contains(element)) return;
+            if (!small->full()) {
+                small->append(element);
+                return;
+            }
+            growAndAdd(element);
+            return;
+        }
+        std::get<Large>(impl).add(element);
+    }
+
+    void remove(const T& element) {
+        std::visit([&element](auto& set) { set.remove(element); }, impl);
+        if (Large* large = std::get_if<Large>(&impl)) {
+            if (large->size() <= Policy::shrinkSize) shrink();
+        }
+    }
+
+    bool contains(const T& element) const {
+        return std::visit([&element](const auto& set) { return set.contains(element); }, impl);
+    }
+
+    size_t size() const {
+        return std::visit([](const auto& set) { return set.size(); }, impl);
+    }
+
+    template <typename F>
+    void forEach(F&& f) const {
+        std::visit([&f](const auto& set) { set.forEach(f); }, impl);
+    }
+
+    std::vector<T> toVector() const {
+        std::vector<T> result;
+        result.reserve(size());
+        forEach([&result](const T& element) { result.push_back(element); });
+        return result;
+    }
+
+    bool isInline() const { return impl.index() == 0; }
+    const char* implementationName() const { return isInline() ? "InlineSet" : "SwissSet"; }
+
+    size_t memoryUsage() const {
+        return std::visit([](const auto& set) { return set.memoryUsage(); }, impl);
+    }
+};
+
+} // namespace Generic
+
+
+// 5. Множество для многопоточного чтения
+//
+// Читатели работают с неизменяемым снимком (обычной реализацией SetImpl),
+// указатель на который публикуется атомарно. Писатель под мьютексом
+// копирует снимок, меняет копию и подменяет указатель; старый снимок
+// освобождается, когда его гарантированно никто не читает (эпохи).
+// Смена реализации — это просто другой тип следующего снимка, поэтому
+// читатели никогда не ждут.
+
+// Эпохи для безопасного освобождения памяти, которую могут читать другие потоки
+class EpochDomain {
+public:
+    static const size_t maxThreads = 256;
+
+    static EpochDomain& instance() {
+        static EpochDomain domain;
+        return domain;
+    }
+
+    // Поток находится в секции чтения, пока жив Guard
+    class Guard {
+    private:
+        std::atomic<uint64_t>* epoch;
+        bool outer;
+
+    public:
+        Guard() : epoch(&EpochDomain::instance().threadEpoch()) {
+            outer = epoch->load(std::memory_order_relaxed) == 0;
+            if (outer) {
+                // seq_cst: писатель должен увидеть эпоху раньше, чем поток прочитает указатель
+                epoch->store(EpochDomain::instance().global.load(std::memory_order_seq_cst), std::memory_order_seq_cst);
+            }
+        }
+        ~Guard() {
+            if (outer) epoch->store(0, std::memory_order_release);
+        }
+
+        Guard(const Guard&) = delete;
+        Guard& operator=(const Guard&) = delete;
+    };
+
+    // Завершить эпоху; возвращает её номер. Память, убранная из общего
+    // доступа до вызова, свободна, когда minActiveEpoch() больше этого номера
+    uint64_t advance() { return global.fetch_add(1, std::memory_order_seq_cst); }
+
+    uint64_t minActiveEpoch() const {
+        uint64_t result = UINT64_MAX;
+        for (const Slot& slot : slots) {
+            uint64_t epoch = slot.epoch.load(std::memory_order_seq_cst);
+            if (epoch != 0 && epoch < result) result = epoch;
+        }
+        return result;
+    }
+
+private:
+    // Отдельная кэш-линия на поток, чтобы читатели не мешали друг другу
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> epoch{0};  // 0 — поток не читает
+        std::atomic<bool> used{false};
+    };
+
+    // Слот освобождается при завершении потока
+    struct ThreadSlot {
+        Slot* slot = nullptr;
+        ~ThreadSlot() {
+            if (slot != nullptr) slot->used.store(false, std::memory_order_release);
+        }
+    };
+
+    std::atomic<uint64_t> global{1};
+    Slot slots[maxThreads];
+
+    EpochDomain() {}
+
+    std::atomic<uint64_t>& threadEpoch() {
+        thread_local ThreadSlot local;
+        if (local.slot == nullptr) {
+            for (Slot& slot : slots) {
+                bool expected = false;
+                if (!slot.used.load(std::memory_order_relaxed) &&
+                    slot.used.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+                    local.slot = &slot;
+                    break;
+                }
+            }
+            if (local.slot == nullptr) {
+                throw std::runtime_error("EpochDomain: too many threads");
+            }
+        }
+        return local.slot->epoch;
+    }
+};
+
+class ConcurrentSet {
+private:
+    std::atomic<const SetImpl*> current;
+    size_t threshold;
+
+    // Только для писателей
+    std::mutex writeMutex;
+    std::vector<std::pair<uint64_t, const SetImpl*>> retired;  // эпоха снятия и снимок
+    size_t snapshots = 1;
+
+    static const uint64_t bitmapMaxRange = uint64_t(1) << 28;
+
+    // Снимки только читаются, поэтому выбор — по скорости поиска и цене копии:
+    // плотные значения — битовая карта, остальные — отсортированный массив
+    SetImpl::Kind chooseKind(size_t expectedSize, int low, int high) const {
+        if (expectedSize <= threshold) return SetImpl::ARRAY;
+        uint64_t range = static_cast<uint64_t>(int64_t(high) - int64_t(low)) + 1;
+        if (range <= bitmapMaxRange && range <= 64 * static_cast<uint64_t>(expectedSize)) return SetImpl::BITMAP;
+        return SetImpl::FLAT;
+    }
+
+    // Копия снимка, готовая принять значения из [low, high], с реализацией под expectedSize
+    SetImpl* prepare(const SetImpl* snapshot, size_t expectedSize, int low, int high) const {
+        int oldLow;
+        int oldHigh;
+        if (snapshot->bounds(oldLow, oldHigh)) {
+            low = std::min(low, oldLow);
+            high = std::max(high, oldHigh);
+        }
+        // Копия сначала получает все старые элементы, поэтому места нужно не меньше, чем в снимке
+        SetImpl::Kind kind = chooseKind(std::max(expectedSize, snapshot->size()), low, high);
+        if (kind == snapshot->kind() && snapshot->canHold(low) && snapshot->canHold(high) &&
+            (kind != SetImpl::ARRAY || expectedSize <= threshold)) {
+            return snapshot->clone();
+        }
+
+        SetImpl* result;
+        if (kind == SetImpl::ARRAY) {
+            result = new ArraySet(threshold);
+        } else if (kind == SetImpl::BITMAP) {
+            // Запас по краям, чтобы соседние значения не требовали перестройки
+            int64_t slack = (int64_t(high) - int64_t(low)) / 8 + 64;
+            result = new BitmapSet(static_cast<int>(std::max<int64_t>(int64_t(low) - slack, INT32_MIN)),
+                                   static_cast<int>(std::min<int64_t>(int64_t(high) + slack, INT32_MAX)));
+        } else {
+            std::vector<int> elements = snapshot->toVector();
+            if (!snapshot->isSorted()) std::sort(elements.begin(), elements.end());
+            return new FlatSet(std::move(elements));
+        }
+        result->addAll(snapshot->toVector());
+        return result;
+    }
+
+    void publish(SetImpl* next) {
+        const SetImpl* old = current.exchange(next, std::memory_order_seq_cst);
+        ++snapshots;
+        retired.push_back({EpochDomain::instance().advance(), old});
+        reclaim();
+    }
+
+    void reclaim() {
+        uint64_t active = EpochDomain::instance().minActiveEpoch();
+        size_t kept = 0;
+        for (const auto& item : retired) {
+            if (item.first < active) {
+                delete item.second;
+            } else {
+                retired[kept++] = item;
+            }
+        }
+        retired.resize(kept);
+    }
+
+public:
+    explicit ConcurrentSet(size_t threshold) : current(new ArraySet(threshold)), threshold(threshold) {}
+
+    // Читателей в момент разрушения быть не должно
+    ~ConcurrentSet() {
+        for (const auto& item : retired) delete item.second;
+        delete current.load();
+    }
+
+    ConcurrentSet(const ConcurrentSet&) = delete;
+    ConcurrentSet& operator=(const ConcurrentSet&) = delete;
+
+    // Чтение без блокировок
+    bool contains(int element) const {
+        EpochDomain::Guard guard;
+        return current.load(std::memory_order_seq_cst)->contains(element);
+    }
+
+    size_t size() const {
+        EpochDomain::Guard guard;
+        return current.load(std::memory_order_seq_cst)->size();
+    }
+
+    std::vector<int> toVector() const {
+        EpochDomain::Guard guard;
+        return current.load(std::memory_order_seq_cst)->toVector();
+    }
+
+    SetImpl::Kind implementationKind() const {
+        EpochDomain::Guard guard;
+        return current.load(std::memory_order_seq_cst)->kind();
+    }
+
+    // Каждое изменение копирует снимок; для частых изменений — addAll/removeAll
+    void add(int element) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const SetImpl* snapshot = current.load(std::memory_order_relaxed);
+        if (snapshot->contains(element)) return;
+        SetImpl* next = prepare(snapshot, snapshot->size() + 1, element, element);
+        next->add(element);
+        publish(next);
+    }
+
+    void remove(int element) {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const SetImpl* snapshot = current.load(std::memory_order_relaxed);
+        if (!snapshot->contains(element)) return;
+        int low;
+        int high;
+        snapshot->bounds(low, high);
+        SetImpl* next = prepare(snapshot, snapshot->size() - 1, low, high);
+        next->remove(element);
+        publish(next);
+    }
+
+    void addAll(const std::vector<int>& elements) {
+        if (elements.empty()) return;
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const SetImpl* snapshot = current.load(std::memory_order_relaxed);
+        auto range = std::minmax_element(elements.begin(), elements.end());
+        SetImpl* next = prepare(snapshot, snapshot->size() + elements.size(), *range.first, *range.second);
+        next->addAll(elements);
+        publish(next);
+    }
+
+    void removeAll(const std::vector<int>& elements) {
+        if (elements.empty()) return;
+        std::lock_guard<std::mutex> lock(writeMutex);
+        const SetImpl* snapshot = current.load(std::memory_order_relaxed);
+        int low;
+        int high;
+        if (!snapshot->bounds(low, high)) return;
+        size_t expected = snapshot->size() > elements.size() ? snapshot->size() - elements.size() : 0;
+        SetImpl* next = prepare(snapshot, expected, low, high);
+        for (int element : elements) next->remove(element);
+        publish(next);
+    }
+
+    // Сколько снимков опубликовано и сколько ещё ждут освобождения
+    size_t publishedSnapshots() {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        return snapshots;
+    }
+
+    size_t pendingReclaim() {
+        std::lock_guard<std::mutex> lock(writeMutex);
+        reclaim();
+        return retired.size();
+    }
+};
+
+
+// Замеры производительности: ./hw_prod7 --bench
+using Clock = std::chrono::steady_clock;
+
+static double elapsedMs(Clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+}
+
+static void benchImpl(const char* label, SetImpl* impl, const std::vector<int>& keys, const std::vector<int>& probes) {
+    auto start = Clock::now();
+    for (int key : keys) impl->add(key);
+    double addMs = elapsedMs(start);
+
+    start = Clock::now();
+    size_t hits = 0;
+    for (int probe : probes) hits += impl->contains(probe);
+    double containsMs = elapsedMs(start);
+
+    double bytesPerElement = static_cast<double>(impl->memoryUsage()) / std::max<size_t>(1, impl->size());
+
+    start = Clock::now();
+    for (int key : keys) impl->remove(key);
+    double removeMs = elapsedMs(start);
+
+    double n = static_cast<double>(keys.size());
+    std::cout << "  " << label << ": add " << addMs * 1e6 / n << " нс, contains " << containsMs * 1e6 / probes.size()
+              << " нс, remove " << removeMs * 1e6 / n << " нс, " << bytesPerElement << " байт/элемент"
+              << " (попаданий " << hits << ")" << std::endl;
+    delete impl;
+}
+
+static void benchImplementations() {
+    std::cout << "== Реализации SetImpl (время на операцию)" << std::endl;
+    for (size_t n : {size_t(1000), size_t(100000), size_t(1000000)}) {
+        std::mt19937 rng(static_cast<unsigned>(n));
+
+        // Плотные ключи из диапазона [0, 2n) и разреженные из всего диапазона int
+        for (int dense = 1; dense >= 0; --dense) {
+            std::vector<int> keys(n);
+            std::vector<int> probes(n);
+            for (size_t i = 0; i < n; ++i) {
+                keys[i] = dense ? static_cast<int>(rng() % (2 * n)) : static_cast<int>(rng() >> 1);
+                probes[i] = dense ? static_cast<int>(rng() % (2 * n)) : (i % 2 ? keys[rng() % n] : static_cast<int>(rng() >> 1));
+            }
+
+            std::cout << "n = " << n << (dense ? ", плотные ключи" : ", разреженные ключи") << std::endl;
+            if (n <= 1000) benchImpl("ArraySet", new ArraySet(n), keys, probes);
+            if (n <= 100000) benchImpl("FlatSet", new FlatSet(), keys, probes);
+            benchImpl("HashSet", new HashSet(), keys, probes);
+            if (dense) benchImpl("BitmapSet", new BitmapSet(0, static_cast<int>(2 * n)), keys, probes);
+            benchImpl("RoaringSet", new RoaringSet(), keys, probes);
+        }
+    }
+}
+
+// Прежний способ: копия левого множества и поэлементное добавление
+static Set* legacyIntersect(const Set& a, const Set& b, size_t threshold) {
+    Set* result = new Set(new ArraySet(threshold), threshold);
+    for (int element : a.toVector()) {
+        if (b.contains(element)) result->add(element);
+    }
+    return result;
+}
+
+static Set* legacyUnite(const Set& a, const Set& b, size_t threshold) {
+    Set* result = new Set(new ArraySet(threshold), threshold);
+    for (int element : b.toVector()) result->add(element);
+    for (int element : a.toVector()) result->add(element);
+    return result;
+}
+
+static void benchSetAlgebra() {
+    const size_t threshold = 16;
+    std::cout << "== Операции над множествами" << std::endl;
+    for (size_t n : {size_t(1000), size_t(100000), size_t(10000000)}) {
+        for (size_t ratio : {size_t(1), size_t(100)}) {
+            for (int dense = 1; dense >= 0; --dense) {
+                size_t m = std::max<size_t>(1, n / ratio);
+                std::mt19937 rng(static_cast<unsigned>(n + ratio));
+                uint32_t range = dense ? static_cast<uint32_t>(2 * n) : 0x7FFFFFFFu;
+                Set a(new ArraySet(threshold), threshold);
+                Set b(new ArraySet(threshold), threshold);
+                for (size_t i = 0; i < n; ++i) a.add(static_cast<int>(rng() % range));
+                for (size_t i = 0; i < m; ++i) b.add(static_cast<int>(rng() % range));
+
+                std::cout << "|A| = " << a.size() << " (" << kindName(a.implementationKind()) << "), |B| = "
+                          << b.size() << " (" << kindName(b.implementationKind()) << ")" << std::endl;
+
+                const char* names[] = { "unite", "intersect", "difference", "symmetricDifference" };
+                std::cout << " ";
+                for (int op = 0; op < 4; ++op) {
+                    auto start = Clock::now();
+                    Set* result = a.combine(b, static_cast<Set::Operation>(op));
+                    double ms = elapsedMs(start);
+                    std::cout << " " << names[op] << " " << ms << " мс (" << result->size() << ")";
+                    delete result;
+                }
+                std::cout << std::endl;
+
+                auto start = Clock::now();
+                Set copy(new ArraySet(threshold), threshold);
+                copy.uniteInPlace(a);
+                double copyMs = elapsedMs(start);
+                start = Clock::now();
+                copy.intersectInPlace(b);
+                std::cout << "  intersectInPlace " << elapsedMs(start) << " мс (копия " << copyMs << " мс)";
+
+                if (n <= 100000) {
+                    start = Clock::now();
+                    Set* legacy = legacyIntersect(a, b, threshold);
+                    double legacyIntersectMs = elapsedMs(start);
+                    delete legacy;
+                    start = Clock::now();
+                    legacy = legacyUnite(a, b, threshold);
+                    double legacyUniteMs = elapsedMs(start);
+                    delete legacy;
+                    std::cout << ", поэлементно: unite " << legacyUniteMs << " мс, intersect " << legacyIntersectMs << " мс";
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+}
+
+// Нагрузка, которая держит множество у границы смены реализации; возвращает число операций
+static size_t runOscillation(Set& set, int scenario, size_t rounds) {
+    if (scenario == 0) {
+        // Размер колеблется около threshold: добавление не помещается в ArraySet,
+        // после удаления ArraySet снова выгоднее
+        for (size_t i = 0; i < rounds; ++i) {
+            set.add(-1);
+            set.remove(-1);
+        }
+        return 2 * rounds;
+    }
+
+    // Размер ходит между 1800 и 3600 через границу FlatSet/HashSet (около 2600)
+    std::mt19937 rng(7);
+    std::vector<int> batch(1800);
+    for (size_t i = 0; i < rounds; ++i) {
+        for (int& x : batch) {
+            x = static_cast<int>(rng() >> 1);
+            set.add(x);
+        }
+        for (int x : batch) {
+            set.contains(x);
+            set.remove(x);
+        }
+    }
+    return 3 * batch.size() * rounds;
+}
+
+static void benchOscillation() {
+    const size_t threshold = 32;
+    std::cout << "== Колебания около границы смены реализации" << std::endl;
+
+    SwitchPolicy eager;
+    eager.hysteresis = 0.0;
+    eager.migrationStep = 0;
+    SwitchPolicy standard;
+
+    const char* scenarios[] = { "размер около threshold", "размер около границы FlatSet/HashSet" };
+    const size_t initial[] = { threshold, 1800 };
+    const size_t rounds[] = { 1000000, 500 };
+    for (int scenario = 0; scenario < 2; ++scenario) {
+        for (int hysteresis = 0; hysteresis < 2; ++hysteresis) {
+            Set set(new ArraySet(threshold), threshold);
+            set.setPolicy(hysteresis ? standard : eager);
+            std::mt19937 rng(3);
+            while (set.size() < initial[scenario]) {
+                set.add(static_cast<int>(rng() >> 1));
+            }
+
+            size_t switchesBefore = set.getSwitchStats().switches;
+            size_t movedBefore = set.getSwitchStats().elementsMoved;
+            auto start = Clock::now();
+            size_t operations = runOscillation(set, scenario, rounds[scenario]);
+            double ms = elapsedMs(start);
+
+            const SwitchStats& stats = set.getSwitchStats();
+            std::cout << "  " << scenarios[scenario] << (hysteresis ? ", с гистерезисом: " : ", без гистерезиса: ")
+                      << ms * 1e6 / operations << " нс/операция, переходов " << stats.switches - switchesBefore
+                      << ", перенесено элементов " << stats.elementsMoved - movedBefore
+                      << ", итог " << kindName(set.implementationKind()) << std::endl;
+        }
+    }
+}
+
+// Время на операцию для множества с произвольным интерфейсом; rounds раз
+// строится множество из keys, ищутся probes и удаляются keys
+template <typename SetType, typename T, typename Make, typename Add, typename Contains, typename Remove>
+static void benchKeys(const char* label, Make make, Add add, Contains contains, Remove remove,
+                      const std::vector<T>& keys, const std::vector<T>& probes, size_t rounds) {
+    double addMs = 0.0;
+    double containsMs = 0.0;
+    double removeMs = 0.0;
+    size_t hits = 0;
+    for (size_t r = 0; r < rounds; ++r) {
+        SetType* set = make();
+        auto start = Clock::now();
+        for (const T& key : keys) add(*set, key);
+        addMs += elapsedMs(start);
+
+        start = Clock::now();
+        for (const T& probe : probes) hits += contains(*set, probe);
+        containsMs += elapsedMs(start);
+
+        start = Clock::now();
+        for (const T& key : keys) remove(*set, key);
+        removeMs += elapsedMs(start);
+        delete set;
+    }
+
+    double n = static_cast<double>(keys.size() * rounds);
+    double m = static_cast<double>(probes.size() * rounds);
+    std::cout << "  " << label << ": add " << addMs * 1e6 / n << " нс, contains " << containsMs * 1e6 / m
+              << " нс, remove " << removeMs * 1e6 / n << " нс (попаданий " << hits / rounds << ")" << std::endl;
+}
+
+static void benchGenericSet() {
+    std::cout << "== Generic::Set против std::unordered_set и моста Set" << std::endl;
+    for (size_t n : {size_t(8), size_t(1000), size_t(1000000)}) {
+        size_t rounds = std::max<size_t>(1, 1000000 / n);
+        std::mt19937_64 rng(n);
+
+        // 64-битные идентификаторы; половина запросов — попадания
+        std::vector<uint64_t> ids(n);
+        std::vector<uint64_t> idProbes(n);
+        for (size_t i = 0; i < n; ++i) ids[i] = rng();
+        for (size_t i = 0; i < n; ++i) idProbes[i] = i % 2 ? ids[rng() % n] : rng();
+
+        std::cout << "n = " << n << ", uint64_t" << std::endl;
+        benchKeys<Generic::Set<uint64_t>>("Generic::Set",
+            [] { return new Generic::Set<uint64_t>(); },
+            [](Generic::Set<uint64_t>& s, uint64_t k) { s.add(k); },
+            [](const Generic::Set<uint64_t>& s, uint64_t k) { return s.contains(k); },
+            [](Generic::Set<uint64_t>& s, uint64_t k) { s.remove(k); },
+            ids, idProbes, rounds);
+        benchKeys<std::unordered_set<uint64_t>>("std::unordered_set",
+            [] { return new std::unordered_set<uint64_t>(); },
+            [](std::unordered_set<uint64_t>& s, uint64_t k) { s.insert(k); },
+            [](const std::unordered_set<uint64_t>& s, uint64_t k) { return s.count(k) > 0; },
+            [](std::unordered_set<uint64_t>& s, uint64_t k) { s.erase(k); },
+            ids, idProbes, rounds);
+
+        // Мост работает только с int: те же случайные биты, усечённые до int
+        std::vector<int> ints(n);
+        std::vector<int> intProbes(n);
+        for (size_t i = 0; i < n; ++i) {
+            ints[i] = static_cast<int>(ids[i] >> 33);
+            intProbes[i] = static_cast<int>(idProbes[i] >> 33);
+        }
+        benchKeys<Set>("Set (мост, int)",
+            [] { return new Set(new ArraySet(16), 16); },
+            [](Set& s, int k) { s.add(k); },
+            [](const Set& s, int k) { return s.contains(k); },
+            [](Set& s, int k) { s.remove(k); },
+            ints, intProbes, rounds);
+
+        // Короткие строки (помещаются в SSO-буфер std::string)
+        std::vector<std::string> names(n);
+        std::vector<std::string> nameProbes(n);
+        for (size_t i = 0; i < n; ++i) names[i] = "id" + std::to_string(ids[i] % 10000000000ull);
+        for (size_t i = 0; i < n; ++i) nameProbes[i] = i % 2 ? names[rng() % n] : "id" + std::to_string(rng() % 10000000000ull);
+
+        std::cout << "n = " << n << ", std::string" << std::endl;
+        benchKeys<Generic::Set<std::string>>("Generic::Set",
+            [] { return new Generic::Set<std::string>(); },
+            [](Generic::Set<std::string>& s, const std::string& k) { s.add(k); },
+            [](const Generic::Set<std::string>& s, const std::string& k) { return s.contains(k); },
+            [](Generic::Set<std::string>& s, const std::string& k) { s.remove(k); },
+            names, nameProbes, rounds);
+        benchKeys<std::unordered_set<std::string>>("std::unordered_set",
+            [] { return new std::unordered_set<std::string>(); },
+            [](std::unordered_set<std::string>& s, const std::string& k) { s.insert(k); },
+            [](const std::unordered_set<std::string>& s, const std::string& k) { return s.count(k) > 0; },
+            [](std::unordered_set<std::string>& s, const std::string& k) { s.erase(k); },
+            names, nameProbes, rounds);
+    }
+}
+
+// Потоки-читатели делают reads поисков, один писатель меняет множество раз в
+// writePeriodUs микросекунд; возвращает суммарную пропускную способность, млн операций/с
+template <typename Contains, typename Update>
+static double runReadHeavy(size_t readers, size_t reads, const std::vector<int>& probes, Contains contains,
+                           Update update, unsigned writePeriodUs, size_t& writes) {
+    std::atomic<size_t> running(readers);
+    std::atomic<size_t> hits(0);
+    std::vector<std::thread> threads;
+    auto start = Clock::now();
+    for (size_t t = 0; t < readers; ++t) {
+        threads.emplace_back([&, t] {
+            size_t local = 0;
+            size_t offset = t * 7919;
+            for (size_t i = 0; i < reads; ++i) {
+                local += contains(probes[(offset + i) % probes.size()]);
+            }
+            hits += local;
+            --running;
+        });
+    }
+
+    writes = 0;
+    std::mt19937 rng(1);
+    while (running.load() > 0) {
+        update(static_cast<int>(rng() % (4 * probes.size())), writes % 2 == 0);
+        ++writes;
+        std::this_thread::sleep_for(std::chrono::microseconds(writePeriodUs));
+    }
+    for (std::thread& thread : threads) thread.join();
+    double ms = elapsedMs(start);
+    return static_cast<double>(readers * reads) / ms / 1000.0;
+}
+
+static void benchConcurrentSet() {
+    const size_t n = 100000;
+    const size_t reads = 2000000;
+    const unsigned writePeriodUs = 1000;
+    std::cout << "== ConcurrentSet: чтение из нескольких потоков, редкие изменения (ядер: "
+              << std::thread::hardware_concurrency() << ")" << std::endl;
+
+    std::mt19937 rng(5);
+    std::vector<int> keys(n);
+    for (int& key : keys) key = static_cast<int>(rng() % (4 * n));
+    std::vector<int> probes(1 << 16);
+    for (int& probe : probes) probe = static_cast<int>(rng() % (4 * n));
+
+    for (size_t readers : {size_t(1), size_t(2), size_t(4), size_t(8)}) {
+        ConcurrentSet concurrent(16);
+        concurrent.addAll(keys);
+        size_t writes = 0;
+        double lockFree = runReadHeavy(readers, reads, probes,
+            [&concurrent](int x) { return concurrent.contains(x); },
+            [&concurrent](int x, bool insert) { if (insert) concurrent.add(x); else concurrent.remove(x); },
+            writePeriodUs, writes);
+
+        // Для сравнения: обычный Set под общим мьютексом
+        Set locked(new ArraySet(16), 16);
+        for (int key : keys) locked.add(key);
+        std::mutex mutex;
+        size_t lockedWrites = 0;
+        double withMutex = runReadHeavy(readers, reads, probes,
+            [&](int x) { std::lock_guard<std::mutex> lock(mutex); return locked.contains(x); },
+            [&](int x, bool insert) {
+                std::lock_guard<std::mutex> lock(mutex);
+                if (insert) locked.add(x); else locked.remove(x);
+            },
+            writePeriodUs, lockedWrites);
+
+        std::cout << "  потоков " << readers << ": ConcurrentSet (" << kindName(concurrent.implementationKind()) << ") "
+                  << lockFree << " млн/с, изменений " << writes << ", не освобождено снимков "
+                  << concurrent.pendingReclaim() << "; Set с мьютексом " << withMutex << " млн/с, изменений "
+                  << lockedWrites << std::endl;
+    }
+}
+
+// Поиск с разной долей попаданий: без фильтра и с FilteredSet перед тем же точным множеством
+static void benchFilteredSet() {
+    std::cout << "== FilteredSet: поиск при разной доле попаданий (время на contains)" << std::endl;
+    for (size_t n : {size_t(1) << 16, size_t(1) << 23}) {
+        std::mt19937 rng(static_cast<unsigned>(n) + 46);
+        // Ключи — чётные числа, промахи — нечётные, поэтому промах никогда не попадает
+        std::vector<int> keys(n);
+        for (int& key : keys) key = static_cast<int>(rng() & 0x7FFFFFFEu);
+        std::sort(keys.begin(), keys.end());
+        keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+        std::vector<int> shuffled = keys;
+        std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+        const size_t probeCount = size_t(1) << 22;
+        for (int variant = 0; variant < 4; ++variant) {
+            SetImpl* impl;
+            switch (variant) {
+                case 0: impl = new HashSet(); break;
+                case 1: impl = new FilteredSet(new HashSet()); break;
+                case 2: impl = new FlatSet(); break;
+                default: impl = new FilteredSet(new FlatSet()); break;
+            }
+            impl->addAll(variant >= 2 ? keys : shuffled);
+            std::cout << "  n = " << keys.size() << ", " << (variant % 2 ? "FilteredSet над " : "")
+                      << (variant < 2 ? "HashSet" : "FlatSet") << " ("
+                      << static_cast<double>(impl->memoryUsage()) / (1 << 20) << " МБ):";
+            for (double hitRatio : {0.0, 0.05, 0.5, 1.0}) {
+                std::vector<int> probes(probeCount);
+                for (int& probe : probes) {
+                    bool hit = std::uniform_real_distribution<double>(0.0, 1.0)(rng) < hitRatio;
+                    probe = hit ? keys[rng() % keys.size()] : static_cast<int>(rng() | 1u) & 0x7FFFFFFF;
+                }
+                auto start = Clock::now();
+                size_t hits = 0;
+                for (int probe : probes) hits += impl->contains(probe);
+                double ms = elapsedMs(start);
+                std::cout << " " << hitRatio * 100 << "% — " << ms * 1e6 / probeCount << " нс"
+                          << (hits == 0 && hitRatio > 0.0 ? " (НЕТ ПОПАДАНИЙ)" : "") << ";";
+            }
+            if (const FilteredSet* filtered = dynamic_cast<const FilteredSet*>(impl)) {
+                size_t falsePositives = 0;
+                const size_t misses = size_t(1) << 20;
+                for (size_t i = 0; i < misses; ++i) {
+                    falsePositives += filtered->mayContain(static_cast<int>(rng() | 1u) & 0x7FFFFFFF);
+                }
+                std::cout << " ложных срабатываний " << 100.0 * static_cast<double>(falsePositives) / misses
+                          << "% (фильтр " << static_cast<double>(filtered->filterBytes()) / (1 << 20) << " МБ)";
+            }
+            std::cout << std::endl;
+            delete impl;
+        }
+    }
+
+    // Set сам выбирает FilteredSet, когда поиск в основном промахивается
+    Set set(new ArraySet(16), 16);
+    std::mt19937 rng(47);
+    for (int i = 0; i < 200000; ++i) {
+        set.add(static_cast<int>(rng() & 0x7FFFFFFEu));
+        for (int k = 0; k < 20; ++k) set.contains(static_cast<int>(rng() | 1u) & 0x7FFFFFFF);
+    }
+    std::cout << "  Set при 95% промахов и разреженных ключах: " << kindName(set.implementationKind()) << std::endl;
+}
+
+// Текущий размер резидентной памяти процесса, МБ: всего и в общих страницах файлов
+static void residentMb(double& total, double& shared) {
+    total = shared = 0.0;
+    std::ifstream statm("/proc/self/statm");
+    size_t sizePages = 0;
+    size_t residentPages = 0;
+    size_t sharedPages = 0;
+    if (statm >> sizePages >> residentPages >> sharedPages) {
+        double pageMb = static_cast<double>(::sysconf(_SC_PAGESIZE)) / (1 << 20);
+        total = static_cast<double>(residentPages) * pageMb;
+        shared = static_cast<double>(sharedPages) * pageMb;
+    }
+}
+
+static std::string rssReport() {
+    double total;
+    double shared;
+    residentMb(total, shared);
+    return "RSS " + std::to_string(static_cast<int>(total)) + " МБ, из них общих " +
+           std::to_string(static_cast<int>(shared)) + " МБ";
+}
+
+// Загрузка большого множества: построение через add() против открытия снимка
+static void benchMappedSet() {
+    const size_t n = size_t(1) << 24;
+    const std::string path = "/tmp/hw_prod7_bench.set";
+    std::cout << "== MappedSet: загрузка множества из " << n << " элементов" << std::endl;
+
+    std::mt19937 rng(47);
+    std::vector<int> keys(n);
+    for (int& key : keys) key = static_cast<int>(rng() & 0x7FFFFFFEu);
+    std::vector<int> probes(size_t(1) << 20);
+    for (size_t i = 0; i < probes.size(); ++i) {
+        probes[i] = i % 2 ? keys[rng() % n] : static_cast<int>(rng() | 1u) & 0x7FFFFFFF;
+    }
+
+    auto lookupNs = [&probes](const Set& set, size_t& hits) {
+        hits = 0;
+        auto start = Clock::now();
+        for (int probe : probes) hits += set.contains(probe);
+        return elapsedMs(start) * 1e6 / static_cast<double>(probes.size());
+    };
+
+    size_t hits;
+    size_t expectedHits;
+    {
+        double rssBefore;
+        double sharedBefore;
+        residentMb(rssBefore, sharedBefore);
+        auto start = Clock::now();
+        Set built(new ArraySet(16), 16);
+        for (int key : keys) built.add(key);
+        built.finishMigration();
+        double buildMs = elapsedMs(start);
+        double rssAfter;
+        double sharedAfter;
+        residentMb(rssAfter, sharedAfter);
+        double ns = lookupNs(built, expectedHits);
+        std::cout << "  Set через add(): " << buildMs << " мс (" << kindName(built.implementationKind()) << "), +"
+                  << rssAfter - rssBefore << " МБ собственной памяти, поиск " << ns << " нс" << std::endl;
+
+        start = Clock::now();
+        built.saveSnapshot(path);
+        std::cout << "  запись снимка: " << elapsedMs(start) << " мс" << std::endl;
+    }
+
+    // Холодный старт: вытеснить файл из кэша страниц
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd >= 0) {
+        ::posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        ::close(fd);
+    }
+
+    std::cout << "  до открытия: " << rssReport() << std::endl;
+    auto start = Clock::now();
+    Set mapped(new MappedSet(path), 16);
+    double openMs = elapsedMs(start);
+    std::cout << "  открытие снимка: " << openMs * 1000.0 << " мкс, " << rssReport() << std::endl;
+    double cold = lookupNs(mapped, hits);
+    std::cout << "  поиск, холодный кэш: " << cold << " нс" << (hits == expectedHits ? "" : " (РАСХОЖДЕНИЕ)")
+              << ", " << rssReport() << std::endl;
+    double warm = lookupNs(mapped, hits);
+    std::cout << "  поиск, тёплый кэш: " << warm << " нс" << (hits == expectedHits ? "" : " (РАСХОЖДЕНИЕ)") << std::endl;
+
+    start = Clock::now();
+    bool valid = MappedSet(path).verify();
+    std::cout << "  полная проверка контрольной суммы: " << elapsedMs(start) << " мс"
+              << (valid ? "" : " (ОШИБКА)") << std::endl;
+
+    // Второй процесс открывает тот же файл: страницы уже в кэше и не копируются
+    std::cout.flush();
+    pid_t child = ::fork();
+    if (child == 0) {
+        Set again(new MappedSet(path), 16);
+        size_t childHits;
+        double ns = lookupNs(again, childHits);
+        struct rusage usage;
+        ::getrusage(RUSAGE_SELF, &usage);
+        std::cout << "  другой процесс: поиск " << ns << " нс, чтений с диска " << usage.ru_majflt << ", "
+                  << rssReport() << std::endl;
+        std::cout.flush();
+        ::_exit(0);
+    }
+    if (child > 0) ::waitpid(child, nullptr, 0);
+
+    // Операции над снимками: результат строится в памяти, файл не копируется
+    Set small(new ArraySet(16), 16);
+    for (size_t i = 0; i < 100000; ++i) small.add(keys[rng() % n] + static_cast<int>(i % 2));
+    start = Clock::now();
+    Set* intersection = mapped.intersect(small);
+    double intersectMs = elapsedMs(start);
+    start = Clock::now();
+    Set* difference = small.difference(mapped);
+    double differenceMs = elapsedMs(start);
+    std::cout << "  пересечение со 100000 элементами: " << intersectMs << " мс (" << intersection->size()
+              << "), разность: " << differenceMs << " мс (" << difference->size() << ")" << std::endl;
+    delete intersection;
+    delete difference;
+    ::unlink(path.c_str());
+}
+
+static void runBenchmarks() {
+    benchImplementations();
+    benchFilteredSet();
+    benchSetAlgebra();
+    benchOscillation();
+    benchGenericSet();
+    benchConcurrentSet();
+    benchMappedSet();
+}
+
+// Целые числа через пробелы и переводы строк; читается кусками, чтобы
+// списки на сотни миллионов значений не требовали текста целиком в памяти
+static std::vector<int> readIntegers(std::istream& in) {
+    std::vector<int> result;
+    std::vector<char> buffer(1 << 20);
+    size_t kept = 0;  // незаконченное число с конца предыдущего куска
+    size_t line = 1;
+    for (;;) {
+        in.read(buffer.data() + kept, static_cast<std::streamsize>(buffer.size() - kept));
+        size_t length = kept + static_cast<size_t>(in.gcount());
+        bool last = length < buffer.size();
+        const char* pos = buffer.data();
+        const char* end = buffer.data() + length;
+        for (;;) {
+            while (pos < end && std::isspace(static_cast<unsigned char>(*pos))) line += *pos++ == '\n';
+            const char* token = pos;
+            while (pos < end && !std::isspace(static_cast<unsigned char>(*pos))) ++pos;
+            if (token == pos) break;
+            if (pos == end && !last) {
+                pos = token;
+                break;
+            }
+            int value;
+            auto parsed = std::from_chars(token, pos, value);
+            if (parsed.ec != std::errc() || parsed.ptr != pos) {
+                throw std::runtime_error("Line " + std::to_string(line) + ": invalid integer '" +
+                                         std::string(token, pos) + "'");
+            }
+            result.push_back(value);
+        }
+        kept = static_cast<size_t>(end - pos);
+        if (last) break;
+        if (kept == buffer.size()) throw std::runtime_error("Line " + std::to_string(line) + ": token too long");
+        std::memmove(buffer.data(), pos, kept);
+    }
+    return result;
+}
+
+// Инструменты для снимков:
+//   --write-set <файл> [<список>]  — снимок из целых чисел (без списка — из stdin)
+//   --check-set <файл>             — открыть снимок и проверить контрольные суммы
+static int runSetFileTool(int argc, char* argv[]) {
+    const std::string command = argv[1];
+    try {
+        if (command == "--write-set" && (argc == 3 || argc == 4)) {
+            std::vector<int> elements;
+            if (argc == 4) {
+                std::ifstream in(argv[3], std::ios::binary);
+                if (!in) throw std::runtime_error(std::string("Cannot open '") + argv[3] + "'");
+                elements = readIntegers(in);
+            } else {
+                elements = readIntegers(std::cin);
+            }
+            size_t count = elements.size();
+            MappedSet::save(argv[2], std::move(elements));
+            MappedSet written(argv[2]);
+            std::cout << argv[2] << ": " << written.size() << " elements (" << count - written.size()
+                      << " duplicates removed), " << written.fileBytes() << " bytes" << std::endl;
+            return 0;
+        }
+        if (command == "--check-set" && argc == 3) {
+            MappedSet set(argv[2]);
+            int low;
+            int high;
+            std::cout << argv[2] << ": " << set.size() << " elements";
+            if (set.bounds(low, high)) std::cout << " in [" << low << ", " << high << "]";
+            bool valid = set.verify();
+            std::cout << ", data checksum " << (valid ? "OK" : "MISMATCH") << std::endl;
+            return valid ? 0 : 1;
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    std::cerr << "Usage: " << argv[0] << " --write-set <file> [<integers>] | --check-set <file>" << std::endl;
+    return 2;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        runBenchmarks();
+        return 0;
+    }
+    if (argc > 1 && (std::string(argv[1]) == "--write-set" || std::string(argv[1]) == "--check-set")) {
+        return runSetFileTool(argc, argv);
+    }
 
-int main() {
     size_t threshold = 5;
     Set mySet(new ArraySet(threshold), threshold);
 
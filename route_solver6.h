@@ -0,0 +1,511 @@
+#ifndef ROUTE_SOLVER_H
+#define ROUTE_SOLVER_H
+
+#include "check_point6.h"
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <random>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <stdexcept>
+#include <cstdint>
+
+namespace RouteSolverDetails {
+
+    const size_t none = static_cast<size_t>(-1);
+    const double eps = 1e-9;
+
+    // Задача в «километрах»: штраф необязательного КП пересчитан в расстояние,
+    // которое можно проехать за то же время
+    struct Problem {
+        size_t n = 0;
+        std::vector<double> dist;         // матрица расстояний n x n, км
+        std::vector<double> penaltyKm;
+        std::vector<char> optional;
+        std::vector<std::vector<size_t>> neighbours;  // ближайшие соседи по возрастанию расстояния
+
+        double d(size_t a, size_t b) const { return dist[a * n + b]; }
+    };
+
+    // Текущее решение локального поиска: маршрут из старта (route[0] == 0);
+    // КП, которых нет в route, пропущены
+    struct Tour {
+        std::vector<size_t> route;
+        std::vector<size_t> pos;   // позиция КП в route или none
+        const Problem* problem;
+
+        explicit Tour(const Problem& p) : pos(p.n, none), problem(&p) {}
+
+        void rebuildPositions(size_t from = 0) {
+            for (size_t i = from; i < route.size(); ++i) pos[route[i]] = i;
+        }
+
+        bool visited(size_t x) const { return pos[x] != none; }
+
+        double length() const {
+            double total = 0.0;
+            for (size_t i = 1; i < route.size(); ++i) total += problem->d(route[i - 1], route[i]);
+            return total;
+        }
+
+        double skippedPenaltyKm() const {
+            double total = 0.0;
+            for (size_t x = 0; x < problem->n; ++x) {
+                if (!visited(x)) total += problem->penaltyKm[x];
+            }
+            return total;
+        }
+
+        double objective() const { return length() + skippedPenaltyKm(); }
+
+        // 2-opt для открытого маршрута: разворот отрезка так, чтобы a соединилась с соседом c
+        bool twoOpt() {
+            const Problem& p = *problem;
+            bool improved = false;
+            size_t m = route.size();
+            for (size_t i = 1; i < m; ++i) {
+                size_t a = route[i - 1];
+                size_t b = route[i];
+                double dab = p.d(a, b);
+                for (size_t c : p.neighbours[a]) {
+                    double dac = p.d(a, c);
+                    if (dac >= dab) break;
+                    size_t j = pos[c];
+                    if (j == none) continue;
+
+                    if (j > i) {
+                        // ... a [b ... c] e ...  ->  ... a [c ... b] e ...
+                        double delta = dac - dab;
+                        if (j + 1 < m) delta += p.d(b, route[j + 1]) - p.d(c, route[j + 1]);
+                        if (delta < -eps) {
+                            std::reverse(route.begin() + i, route.begin() + j + 1);
+                            rebuildPositions(i);
+                            improved = true;
+                            break;
+                        }
+                    } else if (j + 2 < i) {
+                        // ... c [cn ... a] b ...  ->  ... c [a ... cn] b ...
+                        size_t cn = route[j + 1];
+                        double delta = dac + p.d(cn, b) - p.d(c, cn) - dab;
+                        if (delta < -eps) {
+                            std::reverse(route.begin() + j + 1, route.begin() + i);
+                            rebuildPositions(j + 1);
+                            improved = true;
+                            break;
+                        }
+                    }
+                }
+            }
+            return improved;
+        }
+
+        // Or-opt: перенос отрезка из 1-3 КП (возможно, развёрнутого) к одному из соседей
+        bool orOpt() {
+            const Problem& p = *problem;
+            size_t m = route.size();
+            for (size_t i = 1; i < m; ++i) {
+                for (size_t len = 1; len <= 3 && i + len <= m; ++len) {
+                    size_t s0 = route[i];
+                    size_t sL = route[i + len - 1];
+                    size_t prev = route[i - 1];
+                    size_t next = i + len < m ? route[i + len] : none;
+                    double removeGain = p.d(prev, s0);
+                    if (next != none) removeGain += p.d(sL, next) - p.d(prev, next);
+
+                    for (size_t end = 0; end < 2; ++end) {
+                        size_t anchor = end == 0 ? s0 : sL;
+                        for (size_t c : p.neighbours[anchor]) {
+                            if (p.d(anchor, c) >= removeGain) break;
+                            size_t j = pos[c];
+                            if (j == none || (j + 1 >= i && j < i + len)) continue;
+                            size_t e = j + 1 < m ? route[j + 1] : none;
+                            double base = e != none ? p.d(c, e) : 0.0;
+                            double forward = p.d(c, s0) + (e != none ? p.d(sL, e) : 0.0) - base;
+                            double reversed = p.d(c, sL) + (e != none ? p.d(s0, e) : 0.0) - base;
+                            double insertCost = std::min(forward, reversed);
+                            if (insertCost - removeGain < -eps) {
+                                std::vector<size_t> segment(route.begin() + i, route.begin() + i + len);
+                                if (reversed < forward) std::reverse(segment.begin(), segment.end());
+                                route.erase(route.begin() + i, route.begin() + i + len);
+                                size_t at = (j < i ? j : j - len) + 1;
+                                route.insert(route.begin() + at, segment.begin(), segment.end());
+                                rebuildPositions(std::min(i, at));
+                                return true;
+                            }
+                        }
+                    }
+                }
+            }
+            return false;
+        }
+
+        // Пропуск необязательных КП, объезд которых дороже штрафа
+        bool dropOptional() {
+            const Problem& p = *problem;
+            bool improved = false;
+            for (size_t i = 1; i < route.size(); ) {
+                size_t x = route[i];
+                if (p.optional[x]) {
+                    size_t prev = route[i - 1];
+                    size_t next = i + 1 < route.size() ? route[i + 1] : none;
+                    double gain = p.d(prev, x) - p.penaltyKm[x];
+                    if (next != none) gain += p.d(x, next) - p.d(prev, next);
+                    if (gain > eps) {
+                        route.erase(route.begin() + i);
+                        pos[x] = none;
+                        rebuildPositions(i);
+                        improved = true;
+                        continue;
+                    }
+                }
+                ++i;
+            }
+            return improved;
+        }
+
+        // Возврат пропущенных КП, если заезд обходится дешевле штрафа
+        bool insertSkipped() {
+            const Problem& p = *problem;
+            bool improved = false;
+            for (size_t x = 1; x < p.n; ++x) {
+                if (visited(x) || !p.optional[x]) continue;
+                size_t m = route.size();
+                double best = std::numeric_limits<double>::infinity();
+                size_t bestAt = none;
+                for (size_t j = 0; j < m; ++j) {
+                    double cost = p.d(route[j], x);
+                    if (j + 1 < m) cost += p.d(x, route[j + 1]) - p.d(route[j], route[j + 1]);
+                    if (cost < best) {
+                        best = cost;
+                        bestAt = j + 1;
+                    }
+                }
+                if (best < p.penaltyKm[x] - eps) {
+                    route.insert(route.begin() + bestAt, x);
+                    rebuildPositions(bestAt);
+                    improved = true;
+                }
+            }
+            return improved;
+        }
+
+        void localSearch() {
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                while (twoOpt()) changed = true;
+                while (orOpt()) changed = true;
+                if (dropOptional()) changed = true;
+                if (insertSkipped()) changed = true;
+            }
+        }
+    };
+
+    // Жадный маршрут «к ближайшему»; при randomized выбирается один из трёх ближайших
+    inline Tour nearestNeighbour(const Problem& p, std::mt19937* rng) {
+        Tour tour(p);
+        std::vector<char> used(p.n, 0);
+        size_t current = 0;
+        used[0] = 1;
+        tour.route.push_back(0);
+
+        for (size_t step = 1; step < p.n; ++step) {
+            size_t best[3] = { none, none, none };
+            for (size_t x = 0; x < p.n; ++x) {
+                if (used[x]) continue;
+                double dx = p.d(current, x);
+                for (size_t k = 0; k < 3; ++k) {
+                    if (best[k] == none || dx < p.d(current, best[k])) {
+                        for (size_t t = 2; t > k; --t) best[t] = best[t - 1];
+                        best[k] = x;
+                        break;
+                    }
+                }
+            }
+            size_t pick = 0;
+            if (rng != nullptr) {
+                size_t choices = best[2] != none ? 3 : (best[1] != none ? 2 : 1);
+                pick = std::uniform_int_distribution<size_t>(0, choices - 1)(*rng);
+            }
+            current = best[pick];
+            used[current] = 1;
+            tour.route.push_back(current);
+        }
+
+        tour.rebuildPositions();
+        return tour;
+    }
+
+    // Точное решение динамикой по подмножествам (Хелд-Карп), старт в КП 0
+    inline Tour exact(const Problem& p) {
+        Tour tour(p);
+        tour.route.push_back(0);
+        size_t m = p.n - 1;
+        if (m == 0) {
+            tour.rebuildPositions();
+            return tour;
+        }
+
+        const double inf = std::numeric_limits<double>::infinity();
+        size_t full = size_t(1) << m;
+        std::vector<double> dp(full * m, inf);
+        std::vector<std::uint8_t> parent(full * m, 0xFF);
+
+        std::uint64_t mandatoryMask = 0;
+        double penaltyAll = 0.0;
+        for (size_t k = 0; k < m; ++k) {
+            if (!p.optional[k + 1]) mandatoryMask |= std::uint64_t(1) << k;
+            else penaltyAll += p.penaltyKm[k + 1];
+            dp[(size_t(1) << k) * m + k] = p.d(0, k + 1);
+        }
+
+        for (size_t mask = 1; mask < full; ++mask) {
+            for (size_t k = 0; k < m; ++k) {
+                double cur = dp[mask * m + k];
+                if (cur == inf) continue;
+                for (size_t t = 0; t < m; ++t) {
+                    if (mask & (size_t(1) << t)) continue;
+                    size_t next = mask | (size_t(1) << t);
+                    double cand = cur + p.d(k + 1, t + 1);
+                    if (cand < dp[next * m + t]) {
+                        dp[next * m + t] = cand;
+                        parent[next * m + t] = static_cast<std::uint8_t>(k);
+                    }
+                }
+            }
+        }
+
+        double best = mandatoryMask == 0 ? penaltyAll : inf;
+        size_t bestMask = 0;
+        size_t bestLast = none;
+        for (size_t mask = 1; mask < full; ++mask) {
+            if ((mask & mandatoryMask) != mandatoryMask) continue;
+            double skipped = 0.0;
+            for (size_t k = 0; k < m; ++k) {
+                if (!(mask & (size_t(1) << k))) skipped += p.penaltyKm[k + 1];
+            }
+            for (size_t k = 0; k < m; ++k) {
+                double total = dp[mask * m + k] + skipped;
+                if (total < best) {
+                    best = total;
+                    bestMask = mask;
+                    bestLast = k;
+                }
+            }
+        }
+
+        std::vector<size_t> reversed;
+        size_t mask = bestMask;
+        size_t last = bestLast;
+        while (last != none) {
+            reversed.push_back(last + 1);
+            std::uint8_t prev = parent[mask * m + last];
+            mask &= ~(size_t(1) << last);
+            last = prev == 0xFF ? none : prev;
+        }
+        tour.route.insert(tour.route.end(), reversed.rbegin(), reversed.rend());
+        tour.rebuildPositions();
+        return tour;
+    }
+
+} // namespace RouteSolverDetails
+
+// Concrete Builder 5: Оптимальный порядок объезда КП
+//
+// Маршрут начинается в первом добавленном КП и заканчивается в любом.
+// Целевая функция в часах: время в пути (расстояние / скорость) плюс штрафы
+// пропущенных необязательных КП. Обязательные КП пропускать нельзя.
+// До exactLimit КП задача решается точно, иначе — жадным маршрутом и
+// локальным поиском (2-opt, Or-opt, пропуск/возврат КП) с перезапусками,
+// распределёнными по потокам.
+class RouteSolverBuilder : public CheckPointListBuilder {
+public:
+    struct Route {
+        std::vector<size_t> order;    // номера КП в порядке объезда, order[0] — старт
+        std::vector<size_t> skipped;  // пропущенные необязательные КП
+        double distanceKm = 0.0;
+        double penaltyHours = 0.0;
+        double totalHours = 0.0;
+    };
+
+private:
+    std::vector<std::string> names;
+    std::vector<double> latitudes;
+    std::vector<double> longitudes;
+    std::vector<double> penalties;
+    std::vector<char> optional;
+
+    double speedKmh = 60.0;
+    size_t restarts = 8;
+    size_t threadCount = 1;
+    size_t exactLimit = 12;
+    size_t neighbourCount = 10;
+    unsigned seed = 1;
+
+    RouteSolverDetails::Problem makeProblem() const {
+        RouteSolverDetails::Problem p;
+        size_t n = names.size();
+        p.n = n;
+        p.dist.assign(n * n, 0.0);
+        for (size_t a = 0; a < n; ++a) {
+            for (size_t b = a + 1; b < n; ++b) {
+                double d = haversineDistance(latitudes[a], longitudes[a], latitudes[b], longitudes[b]);
+                p.dist[a * n + b] = d;
+                p.dist[b * n + a] = d;
+            }
+        }
+
+        p.optional = optional;
+        p.optional[0] = 0;  // старт посещается всегда
+        p.penaltyKm.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            p.penaltyKm[i] = p.optional[i] ? penalties[i] * speedKmh : 0.0;
+        }
+
+        size_t k = std::min(neighbourCount, n - 1);
+        p.neighbours.resize(n);
+        std::vector<size_t> others;
+        for (size_t a = 0; a < n; ++a) {
+            others.clear();
+            for (size_t b = 0; b < n; ++b) {
+                if (b != a) others.push_back(b);
+            }
+            std::partial_sort(others.begin(), others.begin() + k, others.end(),
+                              [&p, a](size_t x, size_t y) { return p.d(a, x) < p.d(a, y); });
+            p.neighbours[a].assign(others.begin(), others.begin() + k);
+        }
+        return p;
+    }
+
+    Route toRoute(const RouteSolverDetails::Tour& tour) const {
+        Route result;
+        result.order = tour.route;
+        result.distanceKm = tour.length();
+        for (size_t x = 0; x < names.size(); ++x) {
+            if (!tour.visited(x)) {
+                result.skipped.push_back(x);
+                result.penaltyHours += penalties[x];
+            }
+        }
+        result.totalHours = result.distanceKm / speedKmh + result.penaltyHours;
+        return result;
+    }
+
+public:
+    void reset() override {
+        names.clear();
+        latitudes.clear();
+        longitudes.clear();
+        penalties.clear();
+        optional.clear();
+    }
+
+    void addCheckPoint(const CheckPoint& checkPoint) override {
+        names.push_back(checkPoint.getName());
+        latitudes.push_back(checkPoint.getLatitude());
+        longitudes.push_back(checkPoint.getLongitude());
+        bool isOptional = checkPoint.getType() == CheckPoint::Type::OPTIONAL;
+        penalties.push_back(isOptional ? checkPoint.getPenalty() : 0.0);
+        optional.push_back(isOptional ? 1 : 0);
+    }
+
+    CheckPointListBuilder* createChunkBuilder(size_t) const override {
+        return new RouteSolverBuilder();
+    }
+
+    void merge(const CheckPointListBuilder& chunk) override {
+        const RouteSolverBuilder* other = dynamic_cast<const RouteSolverBuilder*>(&chunk);
+        if (other == nullptr) {
+            throw std::invalid_argument("Cannot merge a different builder type into RouteSolverBuilder.");
+        }
+        names.insert(names.end(), other->names.begin(), other->names.end());
+        latitudes.insert(latitudes.end(), other->latitudes.begin(), other->latitudes.end());
+        longitudes.insert(longitudes.end(), other->longitudes.begin(), other->longitudes.end());
+        penalties.insert(penalties.end(), other->penalties.begin(), other->penalties.end());
+        optional.insert(optional.end(), other->optional.begin(), other->optional.end());
+    }
+
+    void setSpeed(double kmh) {
+        if (!(kmh > 0.0)) {
+            throw std::invalid_argument("Speed must be positive.");
+        }
+        speedKmh = kmh;
+    }
+
+    void setRestarts(size_t count) { restarts = std::max<size_t>(1, count); }
+    void setThreadCount(size_t count) { threadCount = std::max<size_t>(1, count); }
+    void setSeed(unsigned value) { seed = value; }
+
+    // Наибольшее число КП, для которого используется точное решение (не больше 20)
+    void setExactLimit(size_t limit) { exactLimit = std::min<size_t>(limit, 20); }
+
+    size_t size() const { return names.size(); }
+    const std::string& getName(size_t id) const { return names.at(id); }
+
+    // Жадный маршрут без локального поиска, для сравнения
+    Route solveGreedy() const {
+        if (names.empty()) {
+            throw std::out_of_range("No checkpoints to route");
+        }
+        RouteSolverDetails::Problem p = makeProblem();
+        RouteSolverDetails::Tour tour = RouteSolverDetails::nearestNeighbour(p, nullptr);
+        return toRoute(tour);
+    }
+
+    Route solve() const {
+        if (names.empty()) {
+            throw std::out_of_range("No checkpoints to route");
+        }
+        RouteSolverDetails::Problem p = makeProblem();
+        if (p.n <= exactLimit) {
+            return toRoute(RouteSolverDetails::exact(p));
+        }
+
+        std::vector<std::vector<size_t>> results(restarts);
+        std::vector<double> objectives(restarts, std::numeric_limits<double>::infinity());
+        std::atomic<size_t> nextRestart(0);
+        std::vector<std::exception_ptr> errors(threadCount);
+
+        auto worker = [&](size_t threadIndex) {
+            try {
+                for (size_t r = nextRestart++; r < restarts; r = nextRestart++) {
+                    std::mt19937 rng(seed + static_cast<unsigned>(r));
+                    RouteSolverDetails::Tour tour = RouteSolverDetails::nearestNeighbour(p, r == 0 ? nullptr : &rng);
+                    tour.localSearch();
+                    objectives[r] = tour.objective();
+                    results[r] = std::move(tour.route);
+                }
+            } catch (...) {
+                errors[threadIndex] = std::current_exception();
+            }
+        };
+
+        size_t workers = std::min(threadCount, restarts);
+        std::vector<std::thread> threads;
+        for (size_t t = 1; t < workers; ++t) {
+            threads.emplace_back(worker, t);
+        }
+        worker(0);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (const auto& error : errors) {
+            if (error) std::rethrow_exception(error);
+        }
+
+        size_t best = 0;
+        for (size_t r = 1; r < restarts; ++r) {
+            if (objectives[r] < objectives[best] - RouteSolverDetails::eps) best = r;
+        }
+
+        RouteSolverDetails::Tour tour(p);
+        tour.route = results[best];
+        tour.rebuildPositions();
+        return toRoute(tour);
+    }
+};
+
+#endif
@@ -0,0 +1,313 @@
+#ifndef SOA_VECTOR_H
+#define SOA_VECTOR_H
+
+#include "hw_prod2.h"
+#include <cstddef>
+#include <new>
+#include <memory>
+#include <tuple>
+#include <utility>
+#include <iterator>
+#include <algorithm>
+#include <stdexcept>
+#include <type_traits>
+
+// Непрерывный участок одного столбца SoAVector
+template <typename T>
+class ColumnSpan {
+private:
+    T* first;
+    std::size_t count;
+
+public:
+    ColumnSpan(T* data, std::size_t size) : first(data), count(size) {}
+
+    T* data() const { return first; }
+    std::size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    T* begin() const { return first; }
+    T* end() const { return first + count; }
+    T& operator[](std::size_t i) const { return first[i]; }
+};
+
+template <typename List>
+class SoAVector;
+
+// Структура массивов по списку типов (хранилище «архетипа»)
+//
+// Для каждого типа из списка — свой непрерывный массив, все массивы лежат в
+// одном блоке памяти и растут вместе. Каждый столбец начинается с границы
+// alignment байт (не меньше кэш-линии), поэтому векторный цикл по столбцу не
+// разрывает строки кэша на первом элементе. Номер столбца для типа
+// вычисляется при компиляции через TypeList::IndexOf, так что column<T>() —
+// просто загрузка указателя. Типы в списке не повторяются.
+//
+//     SoAVector<TypeList::TypeListType<Position, Velocity>> bodies;
+//     bodies.push_back(Position{0, 0}, Velocity{1, 2});
+//     for (Position& p : bodies.column<Position>()) ...
+//     for (auto [p, v] : bodies.rows()) p.x += v.x;
+template <typename... Types>
+class SoAVector<TypeListDetails::TypeList<Types...>> {
+public:
+    using List = TypeList::TypeListType<Types...>;
+
+    static constexpr std::size_t columnCount = sizeof...(Types);
+    static constexpr std::size_t alignment = std::max({ std::size_t(64), alignof(Types)... });
+
+    template <std::size_t Index>
+    using ColumnType = TypeList::TypeAt<List, Index>;
+
+    template <typename T>
+    static constexpr std::size_t indexOf() {
+        constexpr std::size_t index = TypeList::IndexOf<T, List>();
+        static_assert(index != static_cast<std::size_t>(-1), "SoAVector has no column of this type");
+        return index;
+    }
+
+private:
+    static constexpr bool distinctTypes() {
+        std::size_t position = 0;
+        bool distinct = true;
+        ((distinct = distinct && TypeList::IndexOf<Types, List>() == position++), ...);
+        return distinct;
+    }
+
+    static_assert(columnCount > 0, "SoAVector needs at least one column");
+    static_assert(distinctTypes(), "SoAVector column types must be distinct");
+    // Рост и удаление перемещают элементы; без исключений при перемещении
+    // столбцы не могут разойтись по длине
+    static_assert((std::is_nothrow_move_constructible<Types>::value && ...),
+                  "SoAVector column types must be nothrow move constructible");
+
+    using Indices = std::index_sequence_for<Types...>;
+
+    void* block = nullptr;
+    void* columns[columnCount] = {};
+    std::size_t count = 0;
+    std::size_t allocated = 0;
+
+    template <std::size_t Index>
+    ColumnType<Index>* columnData() const {
+        return static_cast<ColumnType<Index>*>(columns[Index]);
+    }
+
+    // Смещения столбцов в блоке на capacity строк; возвращает размер блока
+    static std::size_t layout(std::size_t capacity, std::size_t* offsets) {
+        static constexpr std::size_t sizes[] = { sizeof(Types)... };
+        std::size_t total = 0;
+        for (std::size_t i = 0; i < columnCount; ++i) {
+            offsets[i] = total;
+            total += (sizes[i] * capacity + alignment - 1) / alignment * alignment;
+        }
+        return total;
+    }
+
+    template <typename Function, std::size_t... Index>
+    static void forEachColumn(Function&& function, std::index_sequence<Index...>) {
+        (function(std::integral_constant<std::size_t, Index>()), ...);
+    }
+
+    template <typename Function>
+    static void forEachColumn(Function&& function) {
+        forEachColumn(std::forward<Function>(function), Indices());
+    }
+
+    void reallocate(std::size_t capacity) {
+        std::size_t offsets[columnCount];
+        std::size_t bytes = layout(capacity, offsets);
+        char* newBlock = static_cast<char*>(::operator new(std::max<std::size_t>(bytes, 1), std::align_val_t(alignment)));
+        forEachColumn([&](auto index) {
+            using T = ColumnType<decltype(index)::value>;
+            T* from = columnData<decltype(index)::value>();
+            T* to = reinterpret_cast<T*>(newBlock + offsets[index]);
+            std::uninitialized_move(from, from + count, to);
+            std::destroy(from, from + count);
+            columns[index] = to;
+        });
+        release();
+        block = newBlock;
+        allocated = capacity;
+    }
+
+    void release() {
+        if (block != nullptr) ::operator delete(block, std::align_val_t(alignment));
+        block = nullptr;
+    }
+
+    template <std::size_t... Index>
+    void moveRowIn(std::tuple<Types...>& values, std::index_sequence<Index...>) {
+        (::new (static_cast<void*>(columnData<Index>() + count)) ColumnType<Index>(std::move(std::get<Index>(values))), ...);
+    }
+
+    template <typename Row, std::size_t... Index>
+    Row makeRow(std::size_t position, std::index_sequence<Index...>) const {
+        return Row(columnData<Index>()[position]...);
+    }
+
+public:
+    // Строка как кортеж ссылок на элементы всех столбцов
+    using RowReference = std::tuple<Types&...>;
+    using ConstRowReference = std::tuple<const Types&...>;
+
+    // Итератор по строкам: разыменование даёт кортеж ссылок, поэтому
+    // работают и std::get<T>(row), и структурные привязки
+    template <bool Const>
+    class RowIterator {
+    private:
+        using Owner = typename std::conditional<Const, const SoAVector, SoAVector>::type;
+        Owner* owner;
+        std::size_t row;
+
+    public:
+        using iterator_category = std::forward_iterator_tag;
+        using value_type = typename std::conditional<Const, ConstRowReference, RowReference>::type;
+        using reference = value_type;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+
+        RowIterator(Owner* owner, std::size_t row) : owner(owner), row(row) {}
+
+        reference operator*() const { return owner->row(row); }
+        RowIterator& operator++() {
+            ++row;
+            return *this;
+        }
+        RowIterator operator++(int) {
+            RowIterator previous = *this;
+            ++row;
+            return previous;
+        }
+        bool operator==(const RowIterator& other) const { return row == other.row; }
+        bool operator!=(const RowIterator& other) const { return row != other.row; }
+        std::size_t index() const { return row; }
+    };
+
+    template <bool Const>
+    class RowRange {
+    private:
+        RowIterator<Const> first;
+        RowIterator<Const> last;
+
+    public:
+        RowRange(RowIterator<Const> first, RowIterator<Const> last) : first(first), last(last) {}
+        RowIterator<Const> begin() const { return first; }
+        RowIterator<Const> end() const { return last; }
+    };
+
+    SoAVector() {}
+
+    SoAVector(const SoAVector& other) {
+        reserve(other.count);
+        std::size_t copied = 0;  // столбцов, скопированных целиком
+        try {
+            forEachColumn([&](auto index) {
+                auto from = other.template columnData<decltype(index)::value>();
+                std::uninitialized_copy(from, from + other.count, columnData<decltype(index)::value>());
+                ++copied;
+            });
+        } catch (...) {
+            forEachColumn([&](auto index) {
+                auto data = columnData<decltype(index)::value>();
+                if (index < copied) std::destroy(data, data + other.count);
+            });
+            release();
+            throw;
+        }
+        count = other.count;
+    }
+
+    SoAVector(SoAVector&& other) noexcept
+        : block(other.block), count(other.count), allocated(other.allocated) {
+        std::copy(other.columns, other.columns + columnCount, columns);
+        other.block = nullptr;
+        std::fill(other.columns, other.columns + columnCount, nullptr);
+        other.count = 0;
+        other.allocated = 0;
+    }
+
+    SoAVector& operator=(SoAVector other) noexcept {
+        std::swap(block, other.block);
+        std::swap(columns, other.columns);
+        std::swap(count, other.count);
+        std::swap(allocated, other.allocated);
+        return *this;
+    }
+
+    ~SoAVector() {
+        clear();
+        release();
+    }
+
+    std::size_t size() const { return count; }
+    std::size_t capacity() const { return allocated; }
+    bool empty() const { return count == 0; }
+
+    void reserve(std::size_t capacity) {
+        if (capacity > allocated) reallocate(capacity);
+    }
+
+    void clear() {
+        forEachColumn([&](auto index) {
+            auto data = columnData<decltype(index)::value>();
+            std::destroy(data, data + count);
+        });
+        count = 0;
+    }
+
+    // Значения сначала собираются в кортеж: если конструктор одного из них
+    // бросит исключение, столбцы останутся одной длины
+    void push_back(Types... values) {
+        std::tuple<Types...> row(std::move(values)...);
+        if (count == allocated) reallocate(std::max<std::size_t>(16, allocated * 2));
+        moveRowIn(row, Indices());
+        ++count;
+    }
+
+    void pop_back() {
+        if (count == 0) throw std::out_of_range("SoAVector::pop_back on empty container");
+        --count;
+        forEachColumn([&](auto index) { std::destroy_at(columnData<decltype(index)::value>() + count); });
+    }
+
+    // Удаление без сдвига: на место строки встаёт последняя, порядок строк не сохраняется.
+    // Элемент пересоздаётся перемещением, а не присваивается: так нужна только
+    // проверенная выше гарантия nothrow-перемещения, и столбцы не расходятся
+    void swapErase(std::size_t row) {
+        if (row >= count) throw std::out_of_range("SoAVector::swapErase row out of range");
+        const std::size_t last = count - 1;
+        if (row != last) {
+            forEachColumn([&](auto index) {
+                using T = ColumnType<decltype(index)::value>;
+                T* data = columnData<decltype(index)::value>();
+                std::destroy_at(data + row);
+                ::new (static_cast<void*>(data + row)) T(std::move(data[last]));
+            });
+        }
+        pop_back();
+    }
+
+    // Столбец по типу; номер столбца известен при компиляции
+    template <typename T>
+    ColumnSpan<T> column() {
+        return ColumnSpan<T>(columnData<indexOf<T>()>(), count);
+    }
+
+    template <typename T>
+    ColumnSpan<const T> column() const {
+        return ColumnSpan<const T>(columnData<indexOf<T>()>(), count);
+    }
+
+    template <typename T>
+    T& get(std::size_t row) { return columnData<indexOf<T>()>()[row]; }
+
+    template <typename T>
+    const T& get(std::size_t row) const { return columnData<indexOf<T>()>()[row]; }
+
+    RowReference row(std::size_t position) { return makeRow<RowReference>(position, Indices()); }
+    ConstRowReference row(std::size_t position) const { return makeRow<ConstRowReference>(position, Indices()); }
+
+    RowRange<false> rows() { return RowRange<false>(RowIterator<false>(this, 0), RowIterator<false>(this, count)); }
+    RowRange<true> rows() const { return RowRange<true>(RowIterator<true>(this, 0), RowIterator<true>(this, count)); }
+};
+
+#endif
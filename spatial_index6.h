@@ -0,0 +1,239 @@
+#ifndef SPATIAL_INDEX_H
+#define SPATIAL_INDEX_H
+
+#include "check_point6.h"
+#include <vector>
+#include <string>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cmath>
+
+// Concrete Builder 3: Пространственный индекс КП (k-d дерево)
+//
+// Координаты переводятся в точки на единичной сфере (x, y, z). Длина хорды
+// монотонно зависит от расстояния по большому кругу, поэтому поиск ближайшего
+// КП и КП в радиусе R по евклидовой метрике даёт точный результат без
+// вычисления гаверсинусов для каждой пары.
+class SpatialIndexBuilder : public CheckPointListBuilder {
+public:
+    // Позиция GPS-отметки: (широта, долгота)
+    using Fix = std::pair<double, double>;
+
+    static const size_t npos = static_cast<size_t>(-1);
+
+private:
+    struct Node {
+        double p[3];
+        size_t id;  // порядковый номер КП в порядке добавления
+        int axis;
+    };
+
+    std::vector<Node> nodes;
+    std::vector<std::string> names;
+    std::vector<Fix> coordinates;
+    bool built = false;
+
+    static void toUnitVector(double latitude, double longitude, double out[3]) {
+        const double toRad = M_PI / 180.0;
+        double lat = latitude * toRad;
+        double lon = longitude * toRad;
+        out[0] = std::cos(lat) * std::cos(lon);
+        out[1] = std::cos(lat) * std::sin(lon);
+        out[2] = std::sin(lat);
+    }
+
+    static double squaredDistance(const double a[3], const double b[3]) {
+        double dx = a[0] - b[0];
+        double dy = a[1] - b[1];
+        double dz = a[2] - b[2];
+        return dx * dx + dy * dy + dz * dz;
+    }
+
+    // Квадрат длины хорды, соответствующей дуге radiusKm
+    static double chordSquared(double radiusKm) {
+        double angle = std::min(radiusKm / EARTH_RADIUS_KM, M_PI);
+        double chord = 2.0 * std::sin(angle / 2.0);
+        return chord * chord;
+    }
+
+    // Неявное сбалансированное дерево: корень поддиапазона [lo, hi) лежит в середине
+    void buildRange(size_t lo, size_t hi) {
+        if (hi - lo <= 1) {
+            if (hi > lo) nodes[lo].axis = 0;
+            return;
+        }
+
+        // Делим по оси с наибольшим разбросом
+        double minP[3] = { 2.0, 2.0, 2.0 };
+        double maxP[3] = { -2.0, -2.0, -2.0 };
+        for (size_t i = lo; i < hi; ++i) {
+            for (int k = 0; k < 3; ++k) {
+                minP[k] = std::min(minP[k], nodes[i].p[k]);
+                maxP[k] = std::max(maxP[k], nodes[i].p[k]);
+            }
+        }
+        int axis = 0;
+        for (int k = 1; k < 3; ++k) {
+            if (maxP[k] - minP[k] > maxP[axis] - minP[axis]) axis = k;
+        }
+
+        size_t mid = lo + (hi - lo) / 2;
+        std::nth_element(nodes.begin() + lo, nodes.begin() + mid, nodes.begin() + hi,
+                         [axis](const Node& a, const Node& b) { return a.p[axis] < b.p[axis]; });
+        nodes[mid].axis = axis;
+
+        buildRange(lo, mid);
+        buildRange(mid + 1, hi);
+    }
+
+    void nearestInRange(size_t lo, size_t hi, const double q[3], size_t& bestId, double& bestDist) const {
+        if (lo >= hi) return;
+
+        size_t mid = lo + (hi - lo) / 2;
+        const Node& node = nodes[mid];
+        double d = squaredDistance(node.p, q);
+        if (d < bestDist || (d == bestDist && node.id < bestId)) {
+            bestDist = d;
+            bestId = node.id;
+        }
+
+        double diff = q[node.axis] - node.p[node.axis];
+        if (diff < 0) {
+            nearestInRange(lo, mid, q, bestId, bestDist);
+            if (diff * diff <= bestDist) nearestInRange(mid + 1, hi, q, bestId, bestDist);
+        } else {
+            nearestInRange(mid + 1, hi, q, bestId, bestDist);
+            if (diff * diff <= bestDist) nearestInRange(lo, mid, q, bestId, bestDist);
+        }
+    }
+
+    void radiusInRange(size_t lo, size_t hi, const double q[3], double maxDist, std::vector<size_t>& result) const {
+        if (lo >= hi) return;
+
+        size_t mid = lo + (hi - lo) / 2;
+        const Node& node = nodes[mid];
+        if (squaredDistance(node.p, q) <= maxDist) {
+            result.push_back(node.id);
+        }
+
+        double diff = q[node.axis] - node.p[node.axis];
+        if (diff < 0 || diff * diff <= maxDist) radiusInRange(lo, mid, q, maxDist, result);
+        if (diff >= 0 || diff * diff <= maxDist) radiusInRange(mid + 1, hi, q, maxDist, result);
+    }
+
+    void requireBuilt() const {
+        if (!built) {
+            throw std::logic_error("Spatial index is not built: call build() after adding check points");
+        }
+    }
+
+public:
+    void reset() override {
+        nodes.clear();
+        names.clear();
+        coordinates.clear();
+        built = false;
+    }
+
+    void addCheckPoint(const CheckPoint& checkPoint) override {
+        Node node;
+        toUnitVector(checkPoint.getLatitude(), checkPoint.getLongitude(), node.p);
+        node.id = nodes.size();
+        node.axis = 0;
+        nodes.push_back(node);
+        names.push_back(checkPoint.getName());
+        coordinates.push_back({checkPoint.getLatitude(), checkPoint.getLongitude()});
+        built = false;
+    }
+
+    CheckPointListBuilder* createChunkBuilder(size_t) const override {
+        return new SpatialIndexBuilder();
+    }
+
+    void merge(const CheckPointListBuilder& chunk) override {
+        const SpatialIndexBuilder* other = dynamic_cast<const SpatialIndexBuilder*>(&chunk);
+        if (other == nullptr) {
+            throw std::invalid_argument("Cannot merge a different builder type into SpatialIndexBuilder.");
+        }
+        size_t offset = nodes.size();
+        for (const Node& node : other->nodes) {
+            Node copy = node;
+            copy.id += offset;
+            nodes.push_back(copy);
+        }
+        names.insert(names.end(), other->names.begin(), other->names.end());
+        coordinates.insert(coordinates.end(), other->coordinates.begin(), other->coordinates.end());
+        built = false;
+    }
+
+    // Построение дерева после добавления всех КП. Запросы только читают
+    // дерево, поэтому один построенный индекс можно опрашивать из многих
+    // потоков одновременно; addCheckPoint, merge и reset требуют нового build()
+    void build() {
+        if (!built) {
+            buildRange(0, nodes.size());
+            built = true;
+        }
+    }
+
+    bool isBuilt() const { return built; }
+
+    size_t size() const { return names.size(); }
+    const std::string& getName(size_t id) const { return names.at(id); }
+    Fix getCoordinates(size_t id) const { return coordinates.at(id); }
+
+    // Номер ближайшего к отметке КП
+    size_t nearest(double latitude, double longitude) const {
+        requireBuilt();
+        if (nodes.empty()) {
+            throw std::out_of_range("Spatial index is empty");
+        }
+
+        double q[3];
+        toUnitVector(latitude, longitude, q);
+        size_t bestId = npos;
+        double bestDist = std::numeric_limits<double>::infinity();
+        nearestInRange(0, nodes.size(), q, bestId, bestDist);
+        return bestId;
+    }
+
+    // Номера всех КП на расстоянии не более radiusKm от отметки
+    std::vector<size_t> withinRadius(double latitude, double longitude, double radiusKm) const {
+        std::vector<size_t> result;
+        withinRadius(latitude, longitude, radiusKm, result);
+        return result;
+    }
+
+    void withinRadius(double latitude, double longitude, double radiusKm, std::vector<size_t>& result) const {
+        requireBuilt();
+        result.clear();
+        if (radiusKm < 0) return;
+
+        double q[3];
+        toUnitVector(latitude, longitude, q);
+        radiusInRange(0, nodes.size(), q, chordSquared(radiusKm), result);
+        std::sort(result.begin(), result.end());
+    }
+
+    // Пакетные запросы: по одному ответу на каждую отметку
+    std::vector<size_t> nearest(const std::vector<Fix>& fixes) const {
+        std::vector<size_t> result;
+        result.reserve(fixes.size());
+        for (const auto& fix : fixes) {
+            result.push_back(nearest(fix.first, fix.second));
+        }
+        return result;
+    }
+
+    std::vector<std::vector<size_t>> withinRadius(const std::vector<Fix>& fixes, double radiusKm) const {
+        std::vector<std::vector<size_t>> result(fixes.size());
+        for (size_t i = 0; i < fixes.size(); ++i) {
+            withinRadius(fixes[i].first, fixes[i].second, radiusKm, result[i]);
+        }
+        return result;
+    }
+};
+
+#endif